@@ -0,0 +1,236 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <clocale>
+
+#include "codec.hpp"
+
+// the shortest round-trip representation of any float needs at most 9 significant digits
+static const int MAX_FLOAT_PRECISION = 9;
+
+// scratch size used when a value has to be rewritten for a non "C" locale
+static const size_t MAX_FLOAT_TEXT = 64;
+
+// exact powers of ten representable as doubles
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// magnitudes written in plain notation by the fast path (1e-5 <= |value| < 1e15)
+static const int MIN_FIXED_EXPONENT = -5;
+static const int MAX_FIXED_EXPONENT = 14;
+
+static char decimal_point()
+{
+    // snprintf/strtof follow LC_NUMERIC, so we need to know what they expect
+    const struct lconv *conv = std::localeconv();
+    if (conv == NULL || conv->decimal_point == NULL || conv->decimal_point[0] == '\0')
+        return '.';
+    return conv->decimal_point[0];
+}
+
+static double scale_pow10(double value, int exponent)
+{
+    return exponent < 0 ? value / POW10[-exponent] : value * POW10[exponent];
+}
+
+// finds the fewest digits m such that m * 10^q reads back as value, using only
+// double arithmetic; returns false when the result could be wrong so the caller
+// can use the slow path
+static bool shortest_digits(float value, unsigned long long &mantissa, int &exponent)
+{
+    double magnitude = static_cast<double>(value);
+    int e10 = static_cast<int>(std::floor(std::log10(magnitude)));
+    if (e10 < MIN_FIXED_EXPONENT || e10 > MAX_FIXED_EXPONENT)
+        return false;
+    for (int precision = 1; precision <= MAX_FLOAT_PRECISION; ++precision)
+    {
+        int q = e10 - precision + 1;
+        double digits = std::floor(scale_pow10(magnitude, -q) + 0.5);
+        // m and 10^|q| are exact doubles, so this is a single correctly rounded operation
+        double back = scale_pow10(digits, q);
+        float candidate = static_cast<float>(back);
+        if (candidate != value)
+            continue;
+        // the double -> float step can only round the wrong way from an exact midpoint
+        float neighbour = std::nextafter(candidate, back > static_cast<double>(candidate) ? HUGE_VALF : 0.0f);
+        if (static_cast<double>(candidate) + static_cast<double>(neighbour) == 2.0 * back)
+            return false;
+        mantissa = static_cast<unsigned long long>(digits);
+        exponent = q;
+        return true;
+    }
+    return false;
+}
+
+static size_t write_fixed(char *buffer, bool negative, unsigned long long mantissa, int exponent)
+{
+    while (mantissa != 0 && mantissa % 10 == 0)
+    {
+        mantissa /= 10;
+        ++exponent;
+    }
+    char digits[Codec::INT_BUFFER_SIZE];
+    int count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + mantissa % 10);
+        mantissa /= 10;
+    } while (mantissa != 0);
+    // position of the decimal point counted from the first digit
+    int point = count + exponent;
+    size_t length = 0;
+    if (negative)
+        buffer[length++] = '-';
+    if (point <= 0)
+    {
+        buffer[length++] = '0';
+        buffer[length++] = '.';
+        for (int i = point; i < 0; ++i)
+            buffer[length++] = '0';
+        while (count > 0)
+            buffer[length++] = digits[--count];
+    }
+    else
+    {
+        for (int i = 0; i < point; ++i)
+            buffer[length++] = i < count ? digits[count - 1 - i] : '0';
+        buffer[length++] = '.';
+        if (point >= count)
+            buffer[length++] = '0';
+        for (int i = point; i < count; ++i)
+            buffer[length++] = digits[count - 1 - i];
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+size_t Codec::format_int(char *buffer, int value)
+{
+    char digits[INT_BUFFER_SIZE];
+    size_t count = 0;
+    // going through unsigned keeps INT_MIN well defined
+    unsigned int magnitude = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+    do
+    {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    size_t length = 0;
+    if (value < 0)
+        buffer[length++] = '-';
+    while (count > 0)
+        buffer[length++] = digits[--count];
+    buffer[length] = '\0';
+    return length;
+}
+
+size_t Codec::format_float(char *buffer, float value)
+{
+    if (std::isnan(value))
+    {
+        std::memcpy(buffer, "nan", 4);
+        return 3;
+    }
+    if (std::isinf(value))
+    {
+        const char *text = value < 0 ? "-inf" : "inf";
+        size_t length = std::strlen(text);
+        std::memcpy(buffer, text, length + 1);
+        return length;
+    }
+    bool negative = std::signbit(value);
+    float magnitude = std::fabs(value);
+    if (magnitude == 0.0f)
+        return write_fixed(buffer, negative, 0, 0);
+    unsigned long long mantissa;
+    int exponent;
+    if (shortest_digits(magnitude, mantissa, exponent))
+        return write_fixed(buffer, negative, mantissa, exponent);
+
+    // very large/small values (and the rare ambiguous rounding) go through printf
+    int length = 0;
+    for (int precision = 1; precision <= MAX_FLOAT_PRECISION; ++precision)
+    {
+        length = std::snprintf(buffer, FLOAT_BUFFER_SIZE, "%.*g", precision, static_cast<double>(value));
+        if (std::strtof(buffer, NULL) == value)
+            break;
+    }
+    if (length < 0)
+    {
+        buffer[0] = '\0';
+        return 0;
+    }
+    // and the file always gets a '.', whatever the server locale is
+    char point = decimal_point();
+    if (point != '.')
+    {
+        char *separator = std::strchr(buffer, point);
+        if (separator != NULL)
+            *separator = '.';
+    }
+    return static_cast<size_t>(length);
+}
+
+bool Codec::parse_int(const char *str, int &out, const char **end)
+{
+    const char *p = str;
+    while (*p == ' ' || (*p >= '\t' && *p <= '\r'))
+        ++p;
+    bool negative = false;
+    if (*p == '+' || *p == '-')
+        negative = (*p++ == '-');
+    // the limit is one larger for negative values (INT_MIN)
+    const unsigned int limit = negative ? 2147483648u : 2147483647u;
+    unsigned int result = 0;
+    const char *digits = p;
+    while (*p >= '0' && *p <= '9')
+    {
+        unsigned int digit = static_cast<unsigned int>(*p - '0');
+        if (result > (limit - digit) / 10)
+            return false;
+        result = result * 10 + digit;
+        ++p;
+    }
+    if (p == digits)
+        return false;
+    out = negative ? static_cast<int>(0u - result) : static_cast<int>(result);
+    if (end != NULL)
+        *end = p;
+    return true;
+}
+
+bool Codec::parse_float(const char *str, float &out, const char **end)
+{
+    const char *input = str;
+    char localized[MAX_FLOAT_TEXT];
+    char point = decimal_point();
+    if (point != '.')
+    {
+        // strtof expects the locale separator, so translate ours on a stack copy;
+        // one number never needs more than the scratch size, even inside a list
+        size_t length = 0;
+        while (length < sizeof(localized) - 1 && str[length] != '\0')
+        {
+            localized[length] = str[length];
+            ++length;
+        }
+        localized[length] = '\0';
+        char *separator = std::strchr(localized, '.');
+        if (separator != NULL)
+            *separator = point;
+        input = localized;
+    }
+    char *stop = NULL;
+    errno = 0;
+    float value = std::strtof(input, &stop);
+    // underflow still yields the nearest float, only overflow is an error
+    if (stop == input || (errno == ERANGE && std::isinf(value)))
+        return false;
+    out = value;
+    if (end != NULL)
+        *end = str + (stop - input);
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <cstddef>
+
+/**
+ * @file codec.hpp
+ * @brief Locale-independent numeric formatting and parsing for INI values.
+ *
+ * @details
+ * The Codec class converts integers and floats to and from their textual INI
+ * representation without allocating and without throwing. Floats are written
+ * using the shortest decimal form that reads back to the exact same value
+ * (so 0.008 is stored as "0.008" instead of "0.008000"), and the decimal
+ * separator is always '.', regardless of the process locale.
+ *
+ * All formatting functions write into a caller-provided buffer that must be
+ * at least INT_BUFFER_SIZE / FLOAT_BUFFER_SIZE characters long.
+ *
+ * The class is non-instantiable; all functions are static.
+ */
+class Codec
+{
+public:
+    /**
+     * @brief Minimum buffer size for format_int (sign, 10 digits and terminator).
+     */
+    static const size_t INT_BUFFER_SIZE = 12;
+
+    /**
+     * @brief Minimum buffer size for format_float.
+     */
+    static const size_t FLOAT_BUFFER_SIZE = 32;
+
+    /**
+     * @brief Format an integer as decimal text.
+     *
+     * @param buffer Destination buffer of at least INT_BUFFER_SIZE characters.
+     * @param value Integer to format.
+     * @return Number of characters written, excluding the null terminator.
+     */
+    static size_t format_int(char *buffer, int value);
+
+    /**
+     * @brief Format a float using the shortest representation that round-trips.
+     *
+     * @param buffer Destination buffer of at least FLOAT_BUFFER_SIZE characters.
+     * @param value Float to format.
+     * @return Number of characters written, excluding the null terminator.
+     *
+     * @note The output always uses '.' as the decimal separator.
+     */
+    static size_t format_float(char *buffer, float value);
+
+    /**
+     * @brief Parse a decimal integer.
+     *
+     * @param str Null-terminated input. Leading whitespace is skipped and any
+     *            trailing non-digit characters are ignored.
+     * @param out Receives the parsed value on success.
+     * @param end If not NULL, receives a pointer to the first unparsed character.
+     * @return true if at least one digit was read and the value fits in an int.
+     */
+    static bool parse_int(const char *str, int &out, const char **end = NULL);
+
+    /**
+     * @brief Parse a floating-point value written with '.' as decimal separator.
+     *
+     * @param str Null-terminated input. Leading whitespace is skipped and any
+     *            trailing characters are ignored.
+     * @param out Receives the parsed value on success.
+     * @param end If not NULL, receives a pointer to the first unparsed character.
+     * @return true if a number was read and it does not overflow a float.
+     */
+    static bool parse_float(const char *str, float &out, const char **end = NULL);
+
+private:
+    /**
+     * @brief Private constructor to prevent instantiation.
+     */
+    Codec();
+
+    /**
+     * @brief Private destructor to prevent instantiation.
+     */
+    ~Codec();
+};
+
+#endif
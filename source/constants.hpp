@@ -9,4 +9,14 @@
 
 typedef void (*logprintf_t)(char *, ...);
 
-extern logprintf_t logprintf;
\ No newline at end of file
+extern logprintf_t logprintf;
+
+// parallel flush of modified handles on AmxUnload/Unload
+#ifndef FLUSH_MAX_WORKERS
+#define FLUSH_MAX_WORKERS 8
+#endif
+
+// no new file is started after this many milliseconds (0 = no limit)
+#ifndef FLUSH_TIMEOUT_MS
+#define FLUSH_TIMEOUT_MS 5000
+#endif
@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "container.hpp"
+#include "constants.hpp"
+#include "fileio.hpp"
+
+// marks the start of every record, also used to detect a torn tail
+static const char RECORD_MAGIC[4] = {'P', 'I', 'N', 'I'};
+static const char INDEX_MAGIC[4] = {'P', 'I', 'D', 'X'};
+static const uint32_t INDEX_VERSION = 1;
+
+// magic + key length + data length
+static const uint64_t RECORD_HEADER_SIZE = 12;
+
+// keys longer than this can only come from a corrupt record
+static const uint32_t MAX_KEY_LENGTH = 4096;
+
+// chunk size used to look for the next record after a damaged one
+static const size_t SCAN_CHUNK_SIZE = 65536;
+
+// compaction starts once dead records take at least this much and outweigh live ones
+static const uint64_t COMPACT_MIN_DEAD_BYTES = 1024 * 1024;
+
+static const std::string PATH_SEPARATOR = ".pack:";
+
+// every container opened so far, by file path
+static std::map<std::string, Container *> containers;
+
+static void put_u32(std::ostream &out, uint32_t value)
+{
+    char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8), static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+    out.write(bytes, 4);
+}
+
+static void put_u64(std::ostream &out, uint64_t value)
+{
+    put_u32(out, static_cast<uint32_t>(value));
+    put_u32(out, static_cast<uint32_t>(value >> 32));
+}
+
+static uint32_t get_u32(const unsigned char *bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 | static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+static bool read_u32(std::istream &in, uint32_t &value)
+{
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char *>(bytes), 4))
+        return false;
+    value = get_u32(bytes);
+    return true;
+}
+
+static bool read_u64(std::istream &in, uint64_t &value)
+{
+    uint32_t low, high;
+    if (!read_u32(in, low) || !read_u32(in, high))
+        return false;
+    value = static_cast<uint64_t>(high) << 32 | low;
+    return true;
+}
+
+static bool file_exists(const std::string &path)
+{
+    std::ifstream file(path);
+    return file.is_open();
+}
+
+static uint64_t record_size(size_t key_length, uint32_t length)
+{
+    return RECORD_HEADER_SIZE + key_length + length;
+}
+
+bool Container::split_path(const std::string &path, std::string &container, std::string &key)
+{
+    size_t pos = path.find(PATH_SEPARATOR);
+    if (pos == std::string::npos || pos + PATH_SEPARATOR.size() == path.size())
+        return false;
+    // keep ".pack" in the container path
+    container = path.substr(0, pos + PATH_SEPARATOR.size() - 1);
+    key = path.substr(pos + PATH_SEPARATOR.size());
+    return true;
+}
+
+Container *Container::get(const std::string &path)
+{
+    auto it = containers.find(path);
+    if (it != containers.end())
+        return it->second;
+    Container *container = new Container(path);
+    if (!container->open())
+    {
+        delete container;
+        return NULL;
+    }
+    containers[path] = container;
+    return container;
+}
+
+void Container::close_all()
+{
+    for (auto &pair : containers)
+    {
+        if (pair.second->compactor.joinable())
+            pair.second->compactor.join();
+        pair.second->save_index();
+        delete pair.second;
+    }
+    containers.clear();
+}
+
+Container::Container(const std::string &fpath) : path(fpath), end(0), dead_bytes(0), compacting(false)
+{
+}
+
+Container::~Container()
+{
+    if (compactor.joinable())
+        compactor.join();
+    file.close();
+}
+
+bool Container::open()
+{
+    // the rename of a compaction is atomic, so a leftover .compact is an
+    // unfinished copy and the container itself is still the current version;
+    // only adopt the copy if the container is missing altogether
+    if (file_exists(path + ".compact"))
+    {
+        if (file_exists(path))
+            std::remove((path + ".compact").c_str());
+        else
+            FileIO::replace(path + ".compact", path);
+    }
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open())
+    {
+        std::ofstream create(path, std::ios::binary);
+        if (!create.is_open())
+            return false;
+        create.close();
+        file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!file.is_open())
+            return false;
+    }
+    return scan(load_index());
+}
+
+bool Container::scan(uint64_t offset)
+{
+    file.clear();
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    std::string key;
+    while (offset < size)
+    {
+        uint32_t key_length = 0, length = 0;
+        if (!read_header(offset, size, key_length, length))
+        {
+            // a torn first append still starts with the magic; anything else
+            // (e.g. a file zeroed by a power loss) is not a container we can append to
+            if (offset == 0 && !starts_with_magic(size))
+            {
+                // logprintf takes a char *, a literal would need a cast
+                char format[] = "[pawn-ini | Error] Container %s does not start with a valid record, refusing to open it";
+                logprintf(format, path.c_str());
+                file.clear();
+                return false;
+            }
+            // a torn append leaves nothing valid after it; anything else is damage we must not overwrite
+            uint64_t next = find_record(offset + 1, size);
+            if (next < size)
+            {
+                char format[] = "[pawn-ini | Error] Container %s has a corrupt record at offset %llu (next record at %llu), refusing to open it";
+                logprintf(format, path.c_str(), static_cast<unsigned long long>(offset), static_cast<unsigned long long>(next));
+                file.clear();
+                return false;
+            }
+            break;
+        }
+        key.resize(key_length);
+        if (!file.read(&key[0], key_length))
+            break;
+        auto it = index.find(key);
+        if (it != index.end())
+            dead_bytes += record_size(key.size(), it->second.length);
+        Entry entry = {offset, length};
+        index[key] = entry;
+        offset += record_size(key_length, length);
+    }
+    // anything after this point is a torn append and gets overwritten
+    end = offset;
+    file.clear();
+    return true;
+}
+
+bool Container::read_header(uint64_t offset, uint64_t size, uint32_t &key_length, uint32_t &length)
+{
+    unsigned char header[RECORD_HEADER_SIZE];
+    if (offset + RECORD_HEADER_SIZE > size)
+        return false;
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+    if (!file.read(reinterpret_cast<char *>(header), RECORD_HEADER_SIZE))
+        return false;
+    if (!std::equal(header, header + 4, reinterpret_cast<const unsigned char *>(RECORD_MAGIC)))
+        return false;
+    key_length = get_u32(header + 4);
+    length = get_u32(header + 8);
+    return key_length > 0 && key_length <= MAX_KEY_LENGTH && offset + record_size(key_length, length) <= size;
+}
+
+bool Container::starts_with_magic(uint64_t size)
+{
+    char magic[4];
+    std::streamsize count = static_cast<std::streamsize>(std::min<uint64_t>(sizeof(magic), size));
+    file.clear();
+    file.seekg(0);
+    if (!file.read(magic, count))
+        return false;
+    return std::equal(magic, magic + count, RECORD_MAGIC);
+}
+
+uint64_t Container::find_record(uint64_t offset, uint64_t size)
+{
+    char buffer[SCAN_CHUNK_SIZE];
+    std::vector<uint64_t> candidates;
+    while (offset + RECORD_HEADER_SIZE <= size)
+    {
+        uint64_t count = std::min<uint64_t>(sizeof(buffer), size - offset);
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        if (!file.read(buffer, static_cast<std::streamsize>(count)))
+            break;
+        candidates.clear();
+        for (uint64_t i = 0; i + 4 <= count; ++i)
+            if (std::equal(buffer + i, buffer + i + 4, RECORD_MAGIC))
+                candidates.push_back(offset + i);
+        for (uint64_t candidate : candidates)
+        {
+            uint32_t key_length, length;
+            if (read_header(candidate, size, key_length, length))
+                return candidate;
+        }
+        if (count < sizeof(buffer))
+            break;
+        // overlap by 3 bytes, a magic may straddle two chunks
+        offset += count - 3;
+    }
+    return size;
+}
+
+uint64_t Container::load_index()
+{
+    std::string index_path = path + ".idx";
+    std::ifstream in(index_path, std::ios::binary);
+    if (!in.is_open())
+        return 0;
+    char magic[4];
+    uint32_t version = 0, count = 0;
+    uint64_t covered = 0, dead = 0;
+    bool ok = in.read(magic, 4) && std::equal(magic, magic + 4, INDEX_MAGIC) && read_u32(in, version) && version == INDEX_VERSION && read_u64(in, covered) && read_u64(in, dead) && read_u32(in, count);
+    std::string key;
+    for (uint32_t i = 0; ok && i < count; ++i)
+    {
+        uint32_t key_length = 0;
+        Entry entry;
+        ok = read_u32(in, key_length) && key_length > 0 && key_length <= MAX_KEY_LENGTH;
+        if (!ok)
+            break;
+        key.resize(key_length);
+        ok = in.read(&key[0], key_length) && read_u64(in, entry.offset) && read_u32(in, entry.length);
+        if (ok)
+            index[key] = entry;
+    }
+    in.close();
+    // the index is only trusted once: after a crash the container gets rescanned
+    std::remove(index_path.c_str());
+    // nothing appends after a clean shutdown, so any other size means the
+    // container was replaced (e.g. restored from a backup) and the offsets are stale
+    if (ok)
+    {
+        file.clear();
+        file.seekg(0, std::ios::end);
+        ok = static_cast<uint64_t>(file.tellg()) == covered;
+    }
+    if (!ok)
+    {
+        index.clear();
+        return 0;
+    }
+    dead_bytes = dead;
+    return covered;
+}
+
+void Container::save_index()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::ofstream out(path + ".idx", std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return;
+    out.write(INDEX_MAGIC, 4);
+    put_u32(out, INDEX_VERSION);
+    put_u64(out, end);
+    put_u64(out, dead_bytes);
+    put_u32(out, static_cast<uint32_t>(index.size()));
+    for (const auto &pair : index)
+    {
+        put_u32(out, static_cast<uint32_t>(pair.first.size()));
+        out.write(pair.first.data(), pair.first.size());
+        put_u64(out, pair.second.offset);
+        put_u32(out, pair.second.length);
+    }
+    out.close();
+    if (out.fail())
+        std::remove((path + ".idx").c_str());
+}
+
+Container::ReadResult Container::read(const std::string &key, std::string &out)
+{
+    out.clear();
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = index.find(key);
+    if (it == index.end())
+        return READ_MISSING;
+    return read_entry(it->second, key.size(), out) ? READ_OK : READ_FAILED;
+}
+
+bool Container::write(const std::string &key, const std::string &text)
+{
+    if (key.empty() || key.size() > MAX_KEY_LENGTH)
+        return false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        uint32_t length = static_cast<uint32_t>(text.size());
+        file.clear();
+        file.seekp(static_cast<std::streamoff>(end));
+        if (!write_record(file, key, text.data(), length) || !file.flush())
+        {
+            // end is unchanged, so a partial record is simply overwritten later
+            file.clear();
+            return false;
+        }
+        auto it = index.find(key);
+        if (it != index.end())
+            dead_bytes += record_size(key.size(), it->second.length);
+        Entry entry = {end, length};
+        index[key] = entry;
+        end += record_size(key.size(), length);
+    }
+    maybe_compact();
+    return true;
+}
+
+bool Container::write_record(std::ostream &out, const std::string &key, const char *data, uint32_t length)
+{
+    out.write(RECORD_MAGIC, 4);
+    put_u32(out, static_cast<uint32_t>(key.size()));
+    put_u32(out, length);
+    out.write(key.data(), key.size());
+    out.write(data, length);
+    return !out.fail();
+}
+
+bool Container::read_entry(const Entry &entry, size_t key_length, std::string &out)
+{
+    out.resize(entry.length);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(entry.offset + RECORD_HEADER_SIZE + key_length));
+    if (entry.length > 0 && !file.read(&out[0], entry.length))
+    {
+        file.clear();
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+void Container::maybe_compact()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (compacting || dead_bytes < COMPACT_MIN_DEAD_BYTES || dead_bytes < end - dead_bytes)
+        return;
+    // a previous compaction has finished but was never joined
+    if (compactor.joinable())
+        compactor.join();
+    compacting = true;
+    compactor = std::thread(&Container::compact, this);
+}
+
+void Container::compact()
+{
+    std::string temp_path = path + ".compact";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    bool ok = out.is_open();
+
+    std::map<std::string, Entry> fresh;
+    std::map<std::string, uint64_t> copied_from;
+    uint64_t out_end = 0;
+    std::string text;
+
+    std::vector<std::string> keys;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (const auto &pair : index)
+            keys.push_back(pair.first);
+    }
+    // copy record by record, only holding the lock while reading, so the
+    // server thread can keep loading and saving documents meanwhile
+    for (size_t i = 0; ok && i < keys.size(); ++i)
+    {
+        Entry source;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = index.find(keys[i]);
+            if (it == index.end())
+                continue;
+            source = it->second;
+            ok = read_entry(source, keys[i].size(), text);
+        }
+        ok = ok && write_record(out, keys[i], text.data(), source.length);
+        Entry entry = {out_end, source.length};
+        fresh[keys[i]] = entry;
+        copied_from[keys[i]] = source.offset;
+        out_end += record_size(keys[i].size(), source.length);
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    // documents saved while we were copying still point at the old file
+    for (auto it = index.begin(); ok && it != index.end(); ++it)
+    {
+        auto copied = copied_from.find(it->first);
+        if (copied != copied_from.end() && copied->second == it->second.offset)
+            continue;
+        ok = read_entry(it->second, it->first.size(), text) && write_record(out, it->first, text.data(), it->second.length);
+        Entry entry = {out_end, it->second.length};
+        fresh[it->first] = entry;
+        out_end += record_size(it->first.size(), it->second.length);
+    }
+    out.close();
+    // the copy must be on disk before it replaces the only other copy of every document
+    ok = ok && !out.fail() && FileIO::sync(temp_path);
+    if (!ok)
+    {
+        std::remove(temp_path.c_str());
+        compacting = false;
+        return;
+    }
+    file.close();
+    bool replaced = FileIO::replace(temp_path, path);
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!replaced)
+    {
+        // keep the old file and its index, dead records are reclaimed next time
+        std::remove(temp_path.c_str());
+        compacting = false;
+        return;
+    }
+    index.swap(fresh);
+    end = out_end;
+    dead_bytes = 0;
+    compacting = false;
+}
@@ -0,0 +1,185 @@
+#ifndef CONTAINER_HPP
+#define CONTAINER_HPP
+
+#include <string>
+#include <map>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+/**
+ * @file container.hpp
+ * @brief Packed storage of many small INI documents in a single file.
+ *
+ * @details
+ * A container file ("*.pack") holds many logical INI documents, each stored
+ * under a key. It is opened with INI_Open("path/players.pack:John") and the
+ * returned handle works like any other one; the Handler loads and saves its
+ * document through this class instead of its own file.
+ *
+ * On disk the container is an append-only sequence of records:
+ *
+ *     "PINI" | key length (u32) | data length (u32) | key | INI text
+ *
+ * Saving a document appends a new record and only the in-memory offset index
+ * is updated, so a save is a single append to an already open file. Superseded
+ * records are reclaimed by a background compaction that copies the live
+ * records into "<path>.compact", flushes it to disk and swaps it in atomically.
+ *
+ * The index is written to "<path>.idx" on clean shutdown so the next start
+ * does not have to scan the whole container; it is deleted as soon as it has
+ * been read, so after a crash the container is simply rescanned. A torn
+ * record at the end of the file (crash during an append) is ignored and
+ * overwritten by the next append.
+ *
+ * Containers are opened on first use and kept open until close_all().
+ */
+class Container
+{
+public:
+    /**
+     * @brief Split an INI_Open path of the form "<file>.pack:<key>".
+     *
+     * @param path Path passed to INI_Open.
+     * @param container Receives the container file path.
+     * @param key Receives the document key.
+     * @return true if path refers to a document inside a container.
+     */
+    static bool split_path(const std::string &path, std::string &container, std::string &key);
+
+    /**
+     * @brief Return the open container at path, opening (or creating) it if needed.
+     *
+     * @param path Container file path.
+     * @return The container, or NULL if the file cannot be opened.
+     */
+    static Container *get(const std::string &path);
+
+    /**
+     * @brief Wait for running compactions, write the indexes and close all containers.
+     *
+     * @details Called on plugin Unload, after every pending save has been written.
+     */
+    static void close_all();
+
+    /**
+     * @brief Result of read().
+     */
+    enum ReadResult
+    {
+        READ_OK = 0,  /** The document was read. */
+        READ_MISSING, /** No document with this key exists yet. */
+        READ_FAILED   /** The document exists but could not be read. */
+    };
+
+    /**
+     * @brief Read the INI text of a document.
+     *
+     * @param key Document key.
+     * @param out Receives the document text (left empty unless READ_OK).
+     * @return Whether the document was read, does not exist, or failed to read.
+     */
+    ReadResult read(const std::string &key, std::string &out);
+
+    /**
+     * @brief Store a new version of a document by appending a record.
+     *
+     * @param key Document key.
+     * @param text INI text of the document.
+     * @return true on success, false on I/O error.
+     */
+    bool write(const std::string &key, const std::string &text);
+
+private:
+    /**
+     * @brief Location of the current version of a document.
+     */
+    struct Entry
+    {
+        uint64_t offset; /** Offset of the record header. */
+        uint32_t length; /** Length of the INI text. */
+    };
+
+    Container(const std::string &fpath);
+    ~Container();
+
+    /**
+     * @brief Open the file and build the index (from the .idx file and/or a scan).
+     */
+    bool open();
+
+    /**
+     * @brief Read record headers from offset to the end of the file into index.
+     *
+     * @return false if a record in the middle of the file is damaged.
+     *
+     * @details A malformed record with no complete record after it is a torn
+     *          append: its offset becomes the new end of the container. If a
+     *          complete record follows, the file is damaged and the container is
+     *          refused rather than letting appends overwrite live records.
+     */
+    bool scan(uint64_t offset);
+
+    /**
+     * @brief Read and check the record header at offset.
+     *
+     * @return true if a complete, well-formed record starts at offset.
+     */
+    bool read_header(uint64_t offset, uint64_t size, uint32_t &key_length, uint32_t &length);
+
+    /**
+     * @brief Return whether the file starts with the record magic (or a prefix of it, for tiny files).
+     */
+    bool starts_with_magic(uint64_t size);
+
+    /**
+     * @brief Return the offset of the first complete record at or after offset, or size if there is none.
+     */
+    uint64_t find_record(uint64_t offset, uint64_t size);
+
+    /**
+     * @brief Load and delete the index file, returning the offset it covers (0 if none).
+     *
+     * @details The index is ignored unless it covers exactly the current file size.
+     */
+    uint64_t load_index();
+
+    /**
+     * @brief Write the index file describing the whole container.
+     */
+    void save_index();
+
+    /**
+     * @brief Start a background compaction if enough of the file is dead records.
+     */
+    void maybe_compact();
+
+    /**
+     * @brief Rewrite the container with only the live records (compaction thread).
+     */
+    void compact();
+
+    /**
+     * @brief Write one record at the current put position of out.
+     *
+     * @details The caller holds the lock when out is the container file.
+     */
+    static bool write_record(std::ostream &out, const std::string &key, const char *data, uint32_t length);
+
+    /**
+     * @brief Read the INI text of an entry from the container file (lock held).
+     */
+    bool read_entry(const Entry &entry, size_t key_length, std::string &out);
+
+    std::string path;                     /** Container file path. */
+    std::fstream file;                    /** Container file, opened for reading and appending. */
+    std::map<std::string, Entry> index;   /** Current record of every document. */
+    uint64_t end;                         /** Offset where the next record is appended. */
+    uint64_t dead_bytes;                  /** Bytes taken by superseded records. */
+    std::mutex lock;                      /** Guards everything above against the compaction thread. */
+    std::thread compactor;                /** Running (or finished, not yet joined) compaction. */
+    bool compacting;                      /** Whether the compaction thread is running. */
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FILEIO_HPP
+#define FILEIO_HPP
+
+#include <string>
+
+/**
+ * @file fileio.hpp
+ * @brief Durable whole-file replacement.
+ *
+ * @details
+ * Both plain INI files and container compactions are written to a temporary
+ * file which is then renamed over the original. A rename alone is not enough
+ * after a power loss: the rename may reach the disk before the data does,
+ * leaving an empty or zero-filled file in place of the original. sync() forces
+ * the data out first and replace() makes the rename itself durable.
+ *
+ * The class is non-instantiable; all functions are static.
+ */
+class FileIO
+{
+public:
+    /**
+     * @brief Force the contents of a closed file to disk.
+     *
+     * @param path File to flush.
+     * @return true on success, false if the file cannot be opened or flushed.
+     */
+    static bool sync(const std::string &path);
+
+    /**
+     * @brief Atomically replace one file with another.
+     *
+     * @param from File to move (normally already passed to sync()).
+     * @param to Destination, replaced if it exists.
+     * @return true on success; on failure both files are left as they were.
+     *
+     * @details On POSIX the containing directory is flushed afterwards (best
+     *          effort), on Windows MOVEFILE_WRITE_THROUGH does the same.
+     */
+    static bool replace(const std::string &from, const std::string &to);
+
+private:
+    /**
+     * @brief Private constructor to prevent instantiation.
+     */
+    FileIO();
+
+    /**
+     * @brief Private destructor to prevent instantiation.
+     */
+    ~FileIO();
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "flusher.hpp"
+#include "handler.hpp"
+#include "constants.hpp"
+
+// result of each save, written by its worker and read after the join
+enum SaveState
+{
+    SAVE_PENDING = 0,
+    SAVE_DONE,
+    SAVE_FAILED
+};
+
+int Flusher::save_all(const std::vector<Handler *> &handlers, unsigned int timeout_ms, std::vector<Handler *> &unsaved)
+{
+    if (handlers.empty())
+        return 0;
+
+    // one job per path (indexes into handlers), keeping the order they were given in
+    std::vector<std::vector<size_t>> jobs;
+    std::map<std::string, size_t> job_of_path;
+    for (size_t i = 0; i < handlers.size(); ++i)
+    {
+        auto it = job_of_path.find(handlers[i]->get_path());
+        if (it == job_of_path.end())
+        {
+            job_of_path[handlers[i]->get_path()] = jobs.size();
+            jobs.push_back(std::vector<size_t>(1, i));
+        }
+        else
+            jobs[it->second].push_back(i);
+    }
+
+    std::vector<char> states(handlers.size(), SAVE_PENDING);
+    std::atomic<size_t> next_job(0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            if (timeout_ms > 0 && std::chrono::steady_clock::now() >= deadline)
+                return;
+            size_t job = next_job++;
+            if (job >= jobs.size())
+                return;
+            for (size_t i : jobs[job])
+                states[i] = handlers[i]->save() ? SAVE_DONE : SAVE_FAILED;
+        }
+    };
+
+    size_t count = std::thread::hardware_concurrency();
+    if (count == 0)
+        count = 1;
+    count = std::min(count, std::min(jobs.size(), static_cast<size_t>(FLUSH_MAX_WORKERS)));
+    if (count <= 1)
+        worker();
+    else
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < count; ++i)
+            workers.push_back(std::thread(worker));
+        for (std::thread &thread : workers)
+            thread.join();
+    }
+
+    // back on the server thread: log, free, and hand back what never started
+    int saved = 0;
+    for (size_t i = 0; i < handlers.size(); ++i)
+    {
+        if (states[i] == SAVE_PENDING)
+        {
+            unsaved.push_back(handlers[i]);
+            continue;
+        }
+        if (states[i] == SAVE_FAILED)
+        {
+            logprintf("[pawn-ini | Error] Failed to save %s, changes were lost", handlers[i]->get_path().c_str());
+            handlers[i]->discard_changes();
+        }
+        else
+            ++saved;
+        delete handlers[i];
+    }
+    return saved;
+}
@@ -0,0 +1,51 @@
+#ifndef FLUSHER_HPP
+#define FLUSHER_HPP
+
+#include <vector>
+
+class Handler;
+
+/**
+ * @file flusher.hpp
+ * @brief Parallel saving of many modified handlers at once.
+ *
+ * @details
+ * Used when a lot of files have to be written in one go: when a script is
+ * unloaded (AmxUnload), when the server shuts down (Unload) and when the
+ * deferred save queue is flushed. The handlers are saved by a small pool of
+ * worker threads; handlers that share a path are saved by the same worker, in
+ * order, so two threads never write the same file.
+ *
+ * The class is non-instantiable; all functions are static.
+ */
+class Flusher
+{
+public:
+    /**
+     * @brief Save and free a batch of handlers using several threads.
+     *
+     * @param handlers Handlers to save; the caller gives up ownership of the saved ones.
+     * @param timeout_ms Once this many milliseconds have passed no new file is
+     *                   started (0 = no limit). Saves already running are finished.
+     * @param unsaved Receives the handlers that were not started before the
+     *                timeout; they are not freed and still hold their changes.
+     * @return Number of handlers written successfully.
+     *
+     * @details Failed saves are logged and their changes discarded.
+     *          Must be called from the server thread.
+     */
+    static int save_all(const std::vector<Handler *> &handlers, unsigned int timeout_ms, std::vector<Handler *> &unsaved);
+
+private:
+    /**
+     * @brief Private constructor to prevent instantiation.
+     */
+    Flusher();
+
+    /**
+     * @brief Private destructor to prevent instantiation.
+     */
+    ~Flusher();
+};
+
+#endif
@@ -1,11 +1,61 @@
 #include <algorithm>
 #include <sstream>
 #include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "handler.hpp"
+#include "codec.hpp"
+#include "container.hpp"
+#include "fileio.hpp"
+
+// chunk size used for streaming reads and writes
+static const size_t IO_BUFFER_SIZE = 16384;
+
+// level used for files that are already gzip or end in ".gz"
+#ifdef HAVE_ZLIB
+static const int DEFAULT_COMPRESSION_LEVEL = 6;
+#else
+static const int DEFAULT_COMPRESSION_LEVEL = 0;
+#endif
+
+// separator used by the *_array helpers, e.g. slots=24,31,0,0
+static const char ARRAY_DELIMITER = ',';
+
+// rough heap cost of a map node or staged slot, on top of the characters it holds
+static const size_t ENTRY_OVERHEAD = 48;
 
-Handler::Handler(const std::string &fpath) : file_path(fpath), valid(false), modified(false)
+// shared list parser for read_int_array/read_float_array
+template <typename T, typename Parser>
+static int parse_array(const std::string *value, T *dest, int size, Parser parse)
 {
+    if (value == NULL)
+        return 0;
+    const char *p = value->c_str();
+    int count = 0;
+    while (count < size)
+    {
+        const char *end = NULL;
+        if (!parse(p, dest[count], &end))
+            break;
+        ++count;
+        while (*end == ' ' || *end == '\t')
+            ++end;
+        if (*end != ARRAY_DELIMITER)
+            break;
+        p = end + 1;
+    }
+    return count;
+}
+
+Handler::Handler(const std::string &fpath, bool lazy_load) : file_path(fpath), valid(false), modified(false), compression_level(0), lazy(lazy_load), indexed_stamp(), transaction(false), staged_count(0), loaded(true), footprint(0)
+{
+    footprint = sizeof(Handler) + file_path.capacity();
     load();
 }
 
@@ -17,7 +67,13 @@ Handler::~Handler()
 
 void Handler::load()
 {
-    std::ifstream file(file_path);
+    // "players.pack:John" lives inside a container instead of its own file
+    if (Container::split_path(file_path, container_path, container_key))
+    {
+        valid = load_container();
+        return;
+    }
+    std::ifstream file(file_path, std::ios::binary);
     if (!file.is_open())
     {
         std::ofstream new_file(file_path);
@@ -25,131 +81,558 @@ void Handler::load()
         {
             valid = true;
             new_file.close();
+            // a new "*.gz" file starts out compressed
+            if (has_gzip_extension())
+                compression_level = DEFAULT_COMPRESSION_LEVEL;
         }
         return;
     }
+    char magic[2] = {0, 0};
+    file.read(magic, sizeof(magic));
+    std::streamsize header = file.gcount();
+    file.close();
+    if (header == 2 && static_cast<unsigned char>(magic[0]) == 0x1f && static_cast<unsigned char>(magic[1]) == 0x8b)
+    {
+        // gzip stream, keep it compressed when saving
+        compression_level = DEFAULT_COMPRESSION_LEVEL;
+        valid = load_compressed();
+        return;
+    }
+    if (header == 0 && has_gzip_extension())
+        compression_level = DEFAULT_COMPRESSION_LEVEL;
+    if (lazy)
+        index_sections();
+    else
+        load_plain();
+    valid = true;
+}
+
+void Handler::index_sections()
+{
+    // stamp first: if the file changes while we read it, the next check notices
+    if (!read_stamp(file_path, indexed_stamp))
+        return;
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open())
+        return;
     std::string line;
     std::string current_section;
+    std::streamoff offset = 0;
+    std::streamoff section_start = 0;
+    bool has_keys = false;
+    // key=value lines are not parsed until first access, only checked for existence:
+    // like parse_line, a block without any key does not create its section
     while (std::getline(file, line))
     {
-        trim(line);
-        // this is the case of a comment
-        if (line.empty() || line[0] == ';' || line[0] == '#')
+        std::streamoff line_start = offset;
+        offset += static_cast<std::streamoff>(line.size()) + 1;
+        size_t first = line.find_first_not_of(" \t\r\v\f");
+        if (first == std::string::npos || line[first] == ';' || line[first] == '#')
             continue;
-        // this is the case of a new section
-        if (line[0] == '[' && line[line.length() - 1] == ']')
+        size_t last = line.find_last_not_of(" \t\r\v\f");
+        if (line[first] != '[' || line[last] != ']')
         {
-            current_section = line.substr(1, line.length() - 2);
-            trim(current_section);
+            // a key needs at least one character before the '='
+            size_t pos = line.find('=', first);
+            if (pos != std::string::npos && pos > first)
+                has_keys = true;
             continue;
         }
-        // key=value
-        size_t pos = line.find("=");
-        if (pos != std::string::npos)
+        if (!current_section.empty() && has_keys)
+            unparsed[current_section].push_back(std::make_pair(section_start, line_start - section_start));
+        current_section = line.substr(first + 1, last - first - 1);
+        trim(current_section);
+        section_start = offset;
+        has_keys = false;
+    }
+    if (!current_section.empty() && has_keys)
+        unparsed[current_section].push_back(std::make_pair(section_start, offset - section_start));
+    file.close();
+    for (const auto &section : unparsed)
+        footprint += unparsed_size(section.first, section.second);
+}
+
+void Handler::load_section(const std::string &section)
+{
+    if (unparsed.empty())
+        return;
+    auto it = unparsed.find(section);
+    if (it == unparsed.end())
+        return;
+    FileStamp stamp;
+    if (!read_stamp(file_path, stamp) || stamp.size != indexed_stamp.size || stamp.mtime != indexed_stamp.mtime || stamp.inode != indexed_stamp.inode)
+    {
+        // the file was rewritten since it was indexed, the recorded ranges point at the wrong bytes
+        reindex_sections();
+        it = unparsed.find(section);
+        if (it == unparsed.end())
+            return;
+    }
+    std::ifstream file(file_path, std::ios::binary);
+    if (file.is_open())
+    {
+        std::string text;
+        std::string line;
+        std::string current_section = section;
+        // a section may be split over several [section] blocks, parse them in file order
+        for (const auto &range : it->second)
         {
-            std::string key = line.substr(0, pos);
-            std::string value = line.substr(pos + 1);
-            trim(key);
-            trim(value);
-            if (!current_section.empty() && !key.empty())
-                data[current_section][key] = value;
+            text.resize(static_cast<size_t>(range.second));
+            file.clear();
+            file.seekg(range.first);
+            file.read(&text[0], range.second);
+            parse_buffer(text.data(), static_cast<size_t>(file.gcount()), line, current_section);
+            if (!line.empty())
+                parse_line(line, current_section);
+            line.clear();
         }
+        file.close();
     }
+    footprint -= unparsed_size(it->first, it->second);
+    unparsed.erase(it);
+}
+
+void Handler::load_all_sections()
+{
+    while (!unparsed.empty())
+        load_section(unparsed.begin()->first);
+}
+
+void Handler::reindex_sections()
+{
+    std::map<std::string, std::vector<std::pair<std::streamoff, std::streamoff>>> pending;
+    pending.swap(unparsed);
+    for (const auto &section : pending)
+        footprint -= unparsed_size(section.first, section.second);
+    index_sections();
+    // sections already parsed (or deleted) here keep their in-memory state
+    for (auto it = unparsed.begin(); it != unparsed.end();)
+    {
+        if (pending.find(it->first) == pending.end())
+        {
+            footprint -= unparsed_size(it->first, it->second);
+            it = unparsed.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+bool Handler::read_stamp(const std::string &path, FileStamp &stamp)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+    stamp.size = static_cast<long long>(info.st_size);
+    stamp.mtime = static_cast<long long>(info.st_mtime);
+    stamp.inode = static_cast<unsigned long long>(info.st_ino);
+    return true;
+}
+
+void Handler::load_plain()
+{
+    std::ifstream file(file_path);
+    if (!file.is_open())
+        return;
+    std::string line;
+    std::string current_section;
+    while (std::getline(file, line))
+        parse_line(line, current_section);
     file.close();
-    valid = true;
+}
+
+bool Handler::load_compressed()
+{
+#ifdef HAVE_ZLIB
+    gzFile file = gzopen(file_path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    gzbuffer(file, IO_BUFFER_SIZE);
+    char buffer[IO_BUFFER_SIZE];
+    std::string line;
+    std::string current_section;
+    int read;
+    // inflate chunk by chunk and split lines as they come, the whole file is never in memory
+    while ((read = gzread(file, buffer, sizeof(buffer))) > 0)
+        parse_buffer(buffer, static_cast<size_t>(read), line, current_section);
+    if (!line.empty())
+        parse_line(line, current_section);
+    // a truncated or corrupt stream must not be saved back over the original
+    int error = Z_OK;
+    gzerror(file, &error);
+    gzclose(file);
+    return read == 0 && error == Z_OK;
+#else
+    return false;
+#endif
+}
+
+bool Handler::load_container()
+{
+    Container *container = Container::get(container_path);
+    if (container == NULL)
+        return false;
+    // a missing document is simply a new, empty one, but an unreadable one
+    // must not be, or the next save would replace it with nothing
+    std::string text;
+    if (container->read(container_key, text) == Container::READ_FAILED)
+        return false;
+    std::string line;
+    std::string current_section;
+    parse_buffer(text.data(), text.size(), line, current_section);
+    if (!line.empty())
+        parse_line(line, current_section);
+    return true;
+}
+
+void Handler::parse_buffer(const char *buffer, size_t size, std::string &line, std::string &current_section)
+{
+    const char *p = buffer;
+    const char *end = buffer + size;
+    while (p < end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (newline == NULL)
+        {
+            // incomplete line, the next chunk continues it
+            line.append(p, end);
+            break;
+        }
+        line.append(p, newline);
+        parse_line(line, current_section);
+        line.clear();
+        p = newline + 1;
+    }
+}
+
+void Handler::parse_line(std::string &line, std::string &current_section)
+{
+    trim(line);
+    // this is the case of a comment
+    if (line.empty() || line[0] == ';' || line[0] == '#')
+        return;
+    // this is the case of a new section
+    if (line[0] == '[' && line[line.length() - 1] == ']')
+    {
+        current_section = line.substr(1, line.length() - 2);
+        trim(current_section);
+        return;
+    }
+    // key=value
+    size_t pos = line.find("=");
+    if (pos != std::string::npos)
+    {
+        std::string key = line.substr(0, pos);
+        std::string value = line.substr(pos + 1);
+        trim(key);
+        trim(value);
+        if (!current_section.empty() && !key.empty())
+        {
+            std::string &slot = data_slot(current_section, key);
+            size_t before = slot.capacity();
+            slot.swap(value);
+            resized(before, slot.capacity());
+        }
+    }
 }
 
 bool Handler::save()
 {
-    std::ofstream file(file_path);
+    // an unloaded handler was saved before its data was dropped
+    if (!loaded)
+        return true;
+    // the file is rewritten as a whole, so sections nobody touched must be read first
+    load_all_sections();
+    bool saved;
+    if (!container_path.empty())
+        saved = save_container();
+    else
+    {
+        // write a temporary file first and swap it in, the original stays intact until then
+        std::string temp_path = file_path + ".tmp";
+        saved = compression_level > 0 ? save_compressed(temp_path) : save_plain(temp_path);
+        saved = saved && FileIO::sync(temp_path) && FileIO::replace(temp_path, file_path);
+        if (!saved)
+            std::remove(temp_path.c_str());
+    }
+    if (saved)
+        modified = false;
+    return saved;
+}
+
+bool Handler::save_plain(const std::string &path)
+{
+    std::ofstream file(path);
     if (!file.is_open())
         return false;
+    std::string chunk;
+    chunk.reserve(IO_BUFFER_SIZE);
     for (const auto &section : data)
     {
-        file << "[" << section.first << "]" << std::endl;
-        for (const auto &pair : section.second)
-            file << pair.first << "=" << pair.second << std::endl;
-        file << std::endl;
+        serialize_section(section.first, section.second, chunk);
+        if (chunk.size() >= IO_BUFFER_SIZE)
+        {
+            file.write(chunk.data(), chunk.size());
+            chunk.clear();
+        }
     }
+    file.write(chunk.data(), chunk.size());
     file.close();
-    modified = false;
+    return !file.fail();
+}
+
+bool Handler::save_compressed(const std::string &path)
+{
+#ifdef HAVE_ZLIB
+    char mode[4] = {'w', 'b', static_cast<char>('0' + compression_level), '\0'};
+    gzFile file = gzopen(path.c_str(), mode);
+    if (file == NULL)
+        return false;
+    gzbuffer(file, IO_BUFFER_SIZE);
+    std::string chunk;
+    chunk.reserve(IO_BUFFER_SIZE);
+    bool ok = true;
+    // deflate section by section instead of building the whole file first
+    for (const auto &section : data)
+    {
+        serialize_section(section.first, section.second, chunk);
+        if (chunk.size() >= IO_BUFFER_SIZE)
+        {
+            ok = ok && gzwrite(file, chunk.data(), static_cast<unsigned>(chunk.size())) == static_cast<int>(chunk.size());
+            chunk.clear();
+        }
+    }
+    if (!chunk.empty())
+        ok = ok && gzwrite(file, chunk.data(), static_cast<unsigned>(chunk.size())) == static_cast<int>(chunk.size());
+    return gzclose(file) == Z_OK && ok;
+#else
+    return false;
+#endif
+}
+
+bool Handler::save_container()
+{
+    Container *container = Container::get(container_path);
+    if (container == NULL)
+        return false;
+    std::string text;
+    text.reserve(estimated_size());
+    for (const auto &section : data)
+        serialize_section(section.first, section.second, text);
+    return container->write(container_key, text);
+}
+
+void Handler::serialize_section(const std::string &name, const std::map<std::string, std::string> &pairs, std::string &out)
+{
+    out += '[';
+    out += name;
+    out += "]\n";
+    for (const auto &pair : pairs)
+    {
+        out += pair.first;
+        out += '=';
+        out += pair.second;
+        out += '\n';
+    }
+    out += '\n';
+}
+
+size_t Handler::estimated_size() const
+{
+    size_t size = 0;
+    for (const auto &section : unparsed)
+        for (const auto &range : section.second)
+            size += static_cast<size_t>(range.second);
+    for (const auto &section : data)
+    {
+        // "[name]\n" + trailing blank line
+        size += section.first.size() + 4;
+        for (const auto &pair : section.second)
+            size += pair.first.size() + pair.second.size() + 2;
+    }
+    return size;
+}
+
+size_t Handler::unparsed_size(const std::string &name, const std::vector<std::pair<std::streamoff, std::streamoff>> &ranges)
+{
+    return name.capacity() + ENTRY_OVERHEAD + ranges.capacity() * sizeof(ranges[0]);
+}
+
+size_t Handler::section_size(const std::string &name, const std::map<std::string, std::string> &pairs)
+{
+    size_t size = name.capacity() + ENTRY_OVERHEAD;
+    for (const auto &pair : pairs)
+        size += pair.first.capacity() + pair.second.capacity() + ENTRY_OVERHEAD;
+    return size;
+}
+
+bool Handler::unload()
+{
+    if (modified || transaction)
+        return false;
+    if (!loaded)
+        return true;
+    // swap with empty containers, clear() would keep the capacity of the vector
+    std::map<std::string, std::map<std::string, std::string>>().swap(data);
+    unparsed.clear();
+    std::vector<StagedOp>().swap(staged);
+    staged_count = 0;
+    footprint = sizeof(Handler) + file_path.capacity();
+    loaded = false;
     return true;
 }
 
+bool Handler::reload()
+{
+    if (loaded)
+        return valid;
+    int level = compression_level;
+    valid = false;
+    load();
+    // the file was written with this level before unload(), keep it instead of the detected default
+    compression_level = level;
+    loaded = true;
+    return valid;
+}
+
+bool Handler::set_compression(int level)
+{
+    if (level < 0 || level > 9)
+        return false;
+    // documents inside a container are always stored as plain text
+    if (level > 0 && !container_path.empty())
+        return false;
+#ifndef HAVE_ZLIB
+    if (level > 0)
+        return false;
+#endif
+    // switching between plain and gzip rewrites the file on the next save
+    if ((level > 0) != (compression_level > 0))
+        modified = true;
+    compression_level = level;
+    return true;
+}
+
+bool Handler::has_gzip_extension() const
+{
+    return file_path.size() > 3 && file_path.compare(file_path.size() - 3, 3, ".gz") == 0;
+}
+
 std::string Handler::read_string(const std::string &section, const std::string &key, const std::string &defval)
 {
-    if (!valid)
-        return defval;
-    // we need to find the section first
-    auto section_it = data.find(section);
-    if (section_it == data.end())
-        return defval;
-    // and now the key
-    auto key_it = section_it->second.find(key);
-    if (key_it == section_it->second.end())
+    const std::string *value = find_value(section, key);
+    if (value == NULL)
         return defval;
-    return key_it->second;
+    return *value;
 }
 
 int Handler::read_int(const std::string &section, const std::string &key, int defval)
 {
-    std::string value = read_string(section, key, "");
-    if (value.empty())
+    const std::string *value = find_value(section, key);
+    if (value == NULL || value->empty())
         return defval;
-    try
-    {
-        return std::stoi(value);
-    }
-    catch (...)
-    {
+    int result;
+    if (!Codec::parse_int(value->c_str(), result))
         return defval;
-    }
+    return result;
 }
 
 float Handler::read_float(const std::string &section, const std::string &key, float defval)
 {
-    std::string value = read_string(section, key, "");
-    if (value.empty())
+    const std::string *value = find_value(section, key);
+    if (value == NULL || value->empty())
         return defval;
-    try
-    {
-        return std::stof(value);
-    }
-    catch (...)
-    {
+    float result;
+    if (!Codec::parse_float(value->c_str(), result))
         return defval;
-    }
+    return result;
 }
 
 bool Handler::write_string(const std::string &section, const std::string &key, const std::string &value)
 {
-    if (!valid)
-        return false;
-    data[section][key] = value;
-    modified = true;
-    return true;
+    return write_raw(section, key, value.data(), value.size());
 }
 
 bool Handler::write_int(const std::string &section, const std::string &key, int value)
 {
-    return write_string(section, key, std::to_string(value));
+    char buffer[Codec::INT_BUFFER_SIZE];
+    size_t length = Codec::format_int(buffer, value);
+    return write_raw(section, key, buffer, length);
 }
 
 bool Handler::write_float(const std::string &section, const std::string &key, float value)
 {
-    return write_string(section, key, std::to_string(value));
+    char buffer[Codec::FLOAT_BUFFER_SIZE];
+    size_t length = Codec::format_float(buffer, value);
+    return write_raw(section, key, buffer, length);
+}
+
+int Handler::read_int_array(const std::string &section, const std::string &key, int *dest, int size)
+{
+    return parse_array(find_value(section, key), dest, size, Codec::parse_int);
+}
+
+int Handler::read_float_array(const std::string &section, const std::string &key, float *dest, int size)
+{
+    return parse_array(find_value(section, key), dest, size, Codec::parse_float);
+}
+
+bool Handler::write_int_array(const std::string &section, const std::string &key, const int *values, int count)
+{
+    if (!valid)
+        return false;
+    std::string &target = value_slot(section, key);
+    size_t before = target.capacity();
+    // reusing the stored string keeps rewriting the same inventory allocation-free
+    target.clear();
+    char buffer[Codec::INT_BUFFER_SIZE];
+    for (int i = 0; i < count; ++i)
+    {
+        if (i > 0)
+            target += ARRAY_DELIMITER;
+        target.append(buffer, Codec::format_int(buffer, values[i]));
+    }
+    resized(before, target.capacity());
+    return true;
+}
+
+bool Handler::write_float_array(const std::string &section, const std::string &key, const float *values, int count)
+{
+    if (!valid)
+        return false;
+    std::string &target = value_slot(section, key);
+    size_t before = target.capacity();
+    target.clear();
+    char buffer[Codec::FLOAT_BUFFER_SIZE];
+    for (int i = 0; i < count; ++i)
+    {
+        if (i > 0)
+            target += ARRAY_DELIMITER;
+        target.append(buffer, Codec::format_float(buffer, values[i]));
+    }
+    resized(before, target.capacity());
+    return true;
 }
 
 bool Handler::delete_key(const std::string &section, const std::string &key)
 {
     if (!valid)
         return false;
+    if (transaction)
+    {
+        if (find_value(section, key) == NULL)
+            return false;
+        stage(STAGED_DELETE_KEY, section, key);
+        return true;
+    }
+    load_section(section);
     auto section_it = data.find(section);
     if (section_it == data.end())
         return false;
     auto key_it = section_it->second.find(key);
     if (key_it == section_it->second.end())
         return false;
+    footprint -= key_it->first.capacity() + key_it->second.capacity() + ENTRY_OVERHEAD;
     section_it->second.erase(key_it);
     modified = true;
     return true;
@@ -159,25 +642,188 @@ bool Handler::delete_section(const std::string &section)
 {
     if (!valid)
         return false;
+    if (transaction)
+    {
+        if (!section_exists(section))
+            return false;
+        stage(STAGED_DELETE_SECTION, section, std::string());
+        return true;
+    }
+    bool existed = false;
+    // an unparsed section can be dropped without ever reading it
+    auto unparsed_it = unparsed.find(section);
+    if (unparsed_it != unparsed.end())
+    {
+        footprint -= unparsed_size(unparsed_it->first, unparsed_it->second);
+        unparsed.erase(unparsed_it);
+        existed = true;
+    }
     auto section_it = data.find(section);
-    if (section_it == data.end())
+    if (section_it != data.end())
+    {
+        footprint -= section_size(section_it->first, section_it->second);
+        data.erase(section_it);
+        existed = true;
+    }
+    if (!existed)
         return false;
-    data.erase(section_it);
     modified = true;
     return true;
 }
 
 bool Handler::section_exists(const std::string &section) const
 {
-    return data.find(section) != data.end();
+    // the latest staged operation on the section decides
+    for (size_t i = staged_count; i > 0; --i)
+    {
+        const StagedOp &op = staged[i - 1];
+        if (op.section != section)
+            continue;
+        if (op.type == STAGED_WRITE)
+            return true;
+        if (op.type == STAGED_DELETE_SECTION)
+            return false;
+    }
+    return data.find(section) != data.end() || unparsed.find(section) != unparsed.end();
+}
+
+bool Handler::key_exists(const std::string &section, const std::string &key)
+{
+    return find_value(section, key) != NULL;
+}
+
+bool Handler::begin()
+{
+    if (!valid || transaction)
+        return false;
+    transaction = true;
+    staged_count = 0;
+    return true;
+}
+
+bool Handler::commit(bool save_now)
+{
+    if (!transaction)
+        return false;
+    // leave transaction mode first so the deletes below apply directly
+    transaction = false;
+    for (size_t i = 0; i < staged_count; ++i)
+    {
+        StagedOp &op = staged[i];
+        if (op.type == STAGED_WRITE)
+        {
+            load_section(op.section);
+            // the old value ends up in the slot, ready to be reused by the next transaction;
+            // both strings are counted already, so the swap leaves footprint unchanged
+            data_slot(op.section, op.key).swap(op.value);
+            modified = true;
+        }
+        else if (op.type == STAGED_DELETE_KEY)
+            delete_key(op.section, op.key);
+        else
+            delete_section(op.section);
+    }
+    staged_count = 0;
+    if (save_now && modified)
+        return save();
+    return true;
+}
+
+bool Handler::rollback()
+{
+    if (!transaction)
+        return false;
+    transaction = false;
+    staged_count = 0;
+    return true;
+}
+
+Handler::StagedOp &Handler::stage(char type, const std::string &section, const std::string &key)
+{
+    if (staged_count == staged.size())
+    {
+        staged.push_back(StagedOp());
+        const StagedOp &slot = staged.back();
+        // free slots keep their buffers for the next transaction, so they count too
+        footprint += sizeof(StagedOp) + slot.section.capacity() + slot.key.capacity() + slot.value.capacity();
+    }
+    StagedOp &op = staged[staged_count++];
+    op.type = type;
+    size_t before = op.section.capacity() + op.key.capacity();
+    // assign() keeps the capacity of the strings left in a reused slot
+    op.section.assign(section);
+    op.key.assign(key);
+    resized(before, op.section.capacity() + op.key.capacity());
+    op.value.clear();
+    return op;
 }
 
-bool Handler::key_exists(const std::string &section, const std::string &key) const
+std::string &Handler::value_slot(const std::string &section, const std::string &key)
+{
+    if (transaction)
+        return stage(STAGED_WRITE, section, key).value;
+    load_section(section);
+    modified = true;
+    return data_slot(section, key);
+}
+
+std::string &Handler::data_slot(const std::string &section, const std::string &key)
 {
     auto section_it = data.find(section);
     if (section_it == data.end())
+    {
+        section_it = data.insert(std::make_pair(section, std::map<std::string, std::string>())).first;
+        footprint += section_it->first.capacity() + ENTRY_OVERHEAD;
+    }
+    auto key_it = section_it->second.find(key);
+    if (key_it == section_it->second.end())
+    {
+        key_it = section_it->second.insert(std::make_pair(key, std::string())).first;
+        footprint += key_it->first.capacity() + key_it->second.capacity() + ENTRY_OVERHEAD;
+    }
+    return key_it->second;
+}
+
+const std::string *Handler::find_value(const std::string &section, const std::string &key)
+{
+    if (!valid)
+        return NULL;
+    // staged operations shadow the committed data, newest first
+    for (size_t i = staged_count; i > 0; --i)
+    {
+        const StagedOp &op = staged[i - 1];
+        if (op.section != section)
+            continue;
+        if (op.type == STAGED_DELETE_SECTION)
+            return NULL;
+        if (op.key != key)
+            continue;
+        if (op.type == STAGED_WRITE)
+            return &op.value;
+        return NULL;
+    }
+    load_section(section);
+    // we need to find the section first
+    auto section_it = data.find(section);
+    if (section_it == data.end())
+        return NULL;
+    // and now the key
+    auto key_it = section_it->second.find(key);
+    if (key_it == section_it->second.end())
+        return NULL;
+    return &key_it->second;
+}
+
+bool Handler::write_raw(const std::string &section, const std::string &key, const char *value, size_t length)
+{
+    if (!valid)
         return false;
-    return section_it->second.find(key) != section_it->second.end();
+    std::string &target = value_slot(section, key);
+    size_t before = target.capacity();
+    // assign() reuses the capacity of an existing value instead of allocating a new one
+    target.assign(value, length);
+    resized(before, target.capacity());
+    return true;
 }
 
 void Handler::trim(std::string &s)
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <vector>
+#include <utility>
 
 /**
  * @file handler.h
@@ -21,6 +23,25 @@
  *
  * This header documents the public API and the main private helpers.
  *
+ * Files starting with the gzip magic bytes (or new/empty files whose path
+ * ends in ".gz") are transparently inflated on load and deflated on save,
+ * streaming in fixed-size chunks. This requires building with HAVE_ZLIB.
+ *
+ * In lazy mode only the [section] header lines are scanned on load, recording
+ * their byte ranges; each section is parsed the first time it is accessed,
+ * so opening a huge file to read a single block stays cheap.
+ *
+ * A path of the form "<file>.pack:<key>" refers to a document stored inside
+ * a packed container file (see Container) instead of a file of its own.
+ *
+ * Between begin() and commit() writes and deletes are recorded in a staging
+ * log instead of the data map. Reads see the staged values, commit() applies
+ * the whole log at once and rollback() simply forgets it.
+ *
+ * To bound memory, an idle handler can be unload()ed: its data is dropped and
+ * the Handler object stays around as a placeholder until reload() reads the
+ * file again (see Spiller).
+ *
  * @note This implementation does not guarantee thread-safety.
  */
 class Handler
@@ -31,11 +52,13 @@ public:
      *
      * @param fpath Path to the INI file to load. If the file cannot be opened
      *              or parsed, is_valid() will return false.
+     * @param lazy_load If true, sections of a plain text file are only parsed when
+     *                  first accessed (ignored for gzip files and containers).
      *
      * @details The constructor calls load() to populate the internal data map.
      *          No automatic saving is performed on destruction.
      */
-    Handler(const std::string &fpath);
+    Handler(const std::string &fpath, bool lazy_load = false);
 
     /**
      * @brief Destructor.
@@ -53,6 +76,59 @@ public:
      */
     bool is_valid() const { return valid; }
 
+    /**
+     * @brief Return whether there are in-memory changes not yet saved to disk.
+     */
+    bool is_modified() const { return modified; }
+
+    /**
+     * @brief Return the path this handler loads from and saves to.
+     */
+    const std::string &get_path() const { return file_path; }
+
+    /**
+     * @brief Forget pending changes so the destructor does not save them.
+     *
+     * @details Used when a newer Handler for the same file supersedes this one.
+     */
+    void discard_changes() { modified = false; }
+
+    /**
+     * @brief Approximate size of the file save() would write, in bytes (before compression).
+     */
+    size_t estimated_size() const;
+
+    /**
+     * @brief Approximate heap memory held by the handler, in bytes.
+     *
+     * @details Counts string capacities plus a fixed per-entry overhead for the
+     *          map nodes, so it is an estimate, not an exact figure. The total is
+     *          kept up to date by every change, so this is a constant-time call.
+     */
+    size_t memory_usage() const { return footprint; }
+
+    /**
+     * @brief Return whether the file contents are in memory (false after unload()).
+     */
+    bool is_loaded() const { return loaded; }
+
+    /**
+     * @brief Drop the in-memory contents, keeping only what is needed to reload them.
+     *
+     * @return true if the contents were dropped, false if the handler has unsaved
+     *         changes or an open transaction (save or commit first).
+     */
+    bool unload();
+
+    /**
+     * @brief Read the file again after unload().
+     *
+     * @return true if the handler is loaded and valid afterwards.
+     *
+     * @details The compression level selected before unload() is kept.
+     */
+    bool reload();
+
     /**
      * @brief Read a string value from a section/key.
      *
@@ -71,7 +147,8 @@ public:
      * @param defval Default integer returned if the key is missing or conversion fails.
      * @return The integer value parsed from the stored string, or defval on error.
      *
-     * @note Parsing follows standard stoi-like behavior; non-numeric content yields defval.
+     * @note Parsing follows stoi-like behavior (trailing text is ignored) but never
+     *       throws; non-numeric or out-of-range content yields defval.
      */
     int read_int(const std::string &section, const std::string &key, int defval = 0);
 
@@ -102,7 +179,7 @@ public:
      *
      * @param section Section name.
      * @param key Key name.
-     * @param value Integer value to store (converted to string).
+     * @param value Integer value to store (converted to decimal text).
      * @return true if the in-memory data was changed.
      */
     bool write_int(const std::string &section, const std::string &key, int value);
@@ -112,11 +189,66 @@ public:
      *
      * @param section Section name.
      * @param key Key name.
-     * @param value Float value to store (converted to string).
+     * @param value Float value to store, written in the shortest form that
+     *              reads back to the same float (e.g. 0.008 -> "0.008").
      * @return true if the in-memory data was changed.
+     *
+     * @note The decimal separator is always '.', independent of the locale.
      */
     bool write_float(const std::string &section, const std::string &key, float value);
 
+    /**
+     * @brief Read a delimited list of integers from a section/key into an array.
+     *
+     * @param section Section name.
+     * @param key Key name.
+     * @param dest Destination array.
+     * @param size Capacity of dest, in elements.
+     * @return Number of elements stored in dest. Parsing stops at the first
+     *         malformed element or when dest is full.
+     *
+     * @details Values are stored as "1,2,3" and parsed in place from the stored
+     *          string, without creating a string per element.
+     */
+    int read_int_array(const std::string &section, const std::string &key, int *dest, int size);
+
+    /**
+     * @brief Read a delimited list of floats from a section/key into an array.
+     *
+     * @param section Section name.
+     * @param key Key name.
+     * @param dest Destination array.
+     * @param size Capacity of dest, in elements.
+     * @return Number of elements stored in dest.
+     *
+     * @see read_int_array
+     */
+    int read_float_array(const std::string &section, const std::string &key, float *dest, int size);
+
+    /**
+     * @brief Write an array of integers as a single delimited value.
+     *
+     * @param section Section name.
+     * @param key Key name.
+     * @param values Source array.
+     * @param count Number of elements to write.
+     * @return true if the in-memory data was changed.
+     */
+    bool write_int_array(const std::string &section, const std::string &key, const int *values, int count);
+
+    /**
+     * @brief Write an array of floats as a single delimited value.
+     *
+     * @param section Section name.
+     * @param key Key name.
+     * @param values Source array.
+     * @param count Number of elements to write.
+     * @return true if the in-memory data was changed.
+     *
+     * @note Each element uses the same shortest round-trip format as write_float().
+     */
+    bool write_float_array(const std::string &section, const std::string &key, const float *values, int count);
+
     /**
      * @brief Remove a key from a section in memory.
      *
@@ -141,6 +273,8 @@ public:
      *
      * @param section Section name.
      * @return true if the section exists, false otherwise.
+     *
+     * @note Does not parse the section in lazy mode; knowing it exists is enough.
      */
     bool section_exists(const std::string &section) const;
 
@@ -151,7 +285,7 @@ public:
      * @param key Key name.
      * @return true if the key exists inside the section, false otherwise.
      */
-    bool key_exists(const std::string &section, const std::string &key) const;
+    bool key_exists(const std::string &section, const std::string &key);
 
     /**
      * @brief Persist in-memory changes back to the original file path.
@@ -163,6 +297,51 @@ public:
      */
     bool save();
 
+    /**
+     * @brief Select how the file is stored on the next save().
+     *
+     * @param level 0 to store a plain text file, 1-9 to store a gzip stream
+     *              with that zlib compression level (1 fastest, 9 smallest).
+     * @return true if the level was accepted, false if it is out of range, or
+     *         compression is requested in a build without zlib or for a
+     *         document inside a container.
+     *
+     * @note Switching between plain and compressed marks the handler as modified.
+     */
+    bool set_compression(int level);
+
+    /**
+     * @brief Return the current compression level (0 means plain text).
+     */
+    int get_compression() const { return compression_level; }
+
+    /**
+     * @brief Start a transaction: later writes and deletes are staged, not applied.
+     *
+     * @return true on success, false if the handler is invalid or a transaction is already open.
+     */
+    bool begin();
+
+    /**
+     * @brief Apply every staged write and delete, in order, and end the transaction.
+     *
+     * @param save_now If true, save the file once the changes are applied.
+     * @return false if no transaction is open or the save failed, true otherwise.
+     */
+    bool commit(bool save_now = false);
+
+    /**
+     * @brief Discard every staged write and delete and end the transaction.
+     *
+     * @return false if no transaction is open.
+     */
+    bool rollback();
+
+    /**
+     * @brief Return whether a transaction is open.
+     */
+    bool in_transaction() const { return transaction; }
+
 private:
     /**
      * @brief Path to the INI file used to load/save content.
@@ -194,15 +373,271 @@ private:
      */
     std::map<std::string, std::map<std::string, std::string>> data;
 
+    /**
+     * @brief gzip level used by save(), or 0 to write plain text.
+     *
+     * @details Set from the file format detected by load() and changed with set_compression().
+     */
+    int compression_level;
+
+    /**
+     * @brief Whether sections are parsed on first access instead of on load.
+     */
+    bool lazy;
+
+    /**
+     * @brief Byte ranges (offset, length) of sections not parsed yet, by section name.
+     *
+     * @details Only filled in lazy mode. A section name appearing in several
+     *          [section] blocks has one range per block, in file order.
+     */
+    std::map<std::string, std::vector<std::pair<std::streamoff, std::streamoff>>> unparsed;
+
+    /**
+     * @brief Identifies one version of a file on disk.
+     */
+    struct FileStamp
+    {
+        long long size;           /** File size in bytes. */
+        long long mtime;          /** Last modification time. */
+        unsigned long long inode; /** Inode number (0 where the platform has none). */
+    };
+
+    /**
+     * @brief Stamp of file_path when the unparsed ranges were recorded.
+     *
+     * @details Another handle saving the same path (a second INI_Open, a deferred
+     *          or spill save) rewrites the file and moves every section, so the
+     *          ranges are only used while the file still has this stamp.
+     */
+    FileStamp indexed_stamp;
+
+    /**
+     * @brief Container file and document key, for "<file>.pack:<key>" paths.
+     *
+     * @details Both are empty for ordinary files.
+     */
+    std::string container_path;
+    std::string container_key;
+
+    /**
+     * @brief Kinds of staged operation.
+     */
+    enum
+    {
+        STAGED_WRITE = 0,
+        STAGED_DELETE_KEY,
+        STAGED_DELETE_SECTION
+    };
+
+    /**
+     * @brief One write or delete recorded during a transaction.
+     */
+    struct StagedOp
+    {
+        char type;           /** One of the STAGED_* values. */
+        std::string section; /** Section name. */
+        std::string key;     /** Key name (empty for a section delete). */
+        std::string value;   /** New value of a write. */
+    };
+
+    /**
+     * @brief Whether begin() was called without a matching commit() or rollback().
+     */
+    bool transaction;
+
+    /**
+     * @brief Staging log of the open transaction.
+     *
+     * @details Only the first staged_count entries are live. Slots are kept
+     *          after a commit or rollback so the next transaction reuses their
+     *          strings, which makes rollback() free.
+     */
+    std::vector<StagedOp> staged;
+    size_t staged_count;
+
+    /**
+     * @brief Whether data holds the file contents, false between unload() and reload().
+     */
+    bool loaded;
+
+    /**
+     * @brief Running total returned by memory_usage().
+     *
+     * @details Adjusted wherever data, unparsed or staged gain, lose or resize
+     *          an entry, so the spiller never has to walk the maps.
+     */
+    size_t footprint;
+
     /**
      * @brief Load the INI file referenced by file_path into data.
      *
      * @details Parses sections of the form [section] and lines of the form key=value.
      *          Empty lines and comments (if supported) are ignored.
      *          On parse error, valid may be set to false.
+     *          Detects gzip files and dispatches to load_plain()/load_compressed().
      */
     void load();
 
+    /**
+     * @brief Parse a plain text file line by line.
+     */
+    void load_plain();
+
+    /**
+     * @brief Record the byte range of every section without parsing its keys (lazy mode).
+     */
+    void index_sections();
+
+    /**
+     * @brief Parse a section recorded by index_sections(), if not parsed yet.
+     *
+     * @param section Section name.
+     */
+    void load_section(const std::string &section);
+
+    /**
+     * @brief Parse every section still pending, e.g. before the file is rewritten.
+     */
+    void load_all_sections();
+
+    /**
+     * @brief Index the file again, keeping only the sections that were still unparsed.
+     *
+     * @details Used when the file changed on disk since index_sections().
+     */
+    void reindex_sections();
+
+    /**
+     * @brief Fill stamp with the current size, modification time and inode of path.
+     *
+     * @return false if the file cannot be examined.
+     */
+    static bool read_stamp(const std::string &path, FileStamp &stamp);
+
+    /**
+     * @brief Inflate and parse a gzip file in fixed-size chunks.
+     *
+     * @return true if the whole stream was read, false on I/O or format error
+     *         (or if the plugin was built without zlib).
+     */
+    bool load_compressed();
+
+    /**
+     * @brief Load the document container_key from its container.
+     *
+     * @return false if the container cannot be opened or the document cannot be read.
+     */
+    bool load_container();
+
+    /**
+     * @brief Parse a chunk of INI text, carrying an incomplete last line over.
+     *
+     * @param buffer Chunk of text.
+     * @param size Length of the chunk.
+     * @param line Incomplete line from the previous chunk; receives this chunk's.
+     * @param current_section Section of the previous lines; updated on [section] lines.
+     */
+    void parse_buffer(const char *buffer, size_t size, std::string &line, std::string &current_section);
+
+    /**
+     * @brief Parse one line of INI text into data.
+     *
+     * @param line Raw line (trimmed in-place).
+     * @param current_section Section of the previous lines; updated on [section] lines.
+     */
+    void parse_line(std::string &line, std::string &current_section);
+
+    /**
+     * @brief Write data to path as plain text.
+     *
+     * @details save() writes to a temporary file and renames it over file_path.
+     */
+    bool save_plain(const std::string &path);
+
+    /**
+     * @brief Write data to path as a gzip stream using compression_level.
+     */
+    bool save_compressed(const std::string &path);
+
+    /**
+     * @brief Append the document as a new record of its container.
+     */
+    bool save_container();
+
+    /**
+     * @brief Append the INI text of one section to out.
+     *
+     * @param name Section name.
+     * @param pairs Key/value pairs of the section.
+     * @param out Buffer the text is appended to.
+     */
+    static void serialize_section(const std::string &name, const std::map<std::string, std::string> &pairs, std::string &out);
+
+    /**
+     * @brief Return whether file_path ends in ".gz".
+     */
+    bool has_gzip_extension() const;
+
+    /**
+     * @brief Look up the stored value of a section/key without copying it.
+     *
+     * @param section Section name.
+     * @param key Key name.
+     * @return Pointer to the stored value, or NULL if the handler is invalid or
+     *         the section/key does not exist. Invalidated by any write/delete.
+     */
+    const std::string *find_value(const std::string &section, const std::string &key);
+
+    /**
+     * @brief Store a raw character range as the value of a section/key.
+     *
+     * @param section Section name.
+     * @param key Key name.
+     * @param value Pointer to the value characters.
+     * @param length Number of characters to store.
+     * @return true if the in-memory data was changed, false if the handler is invalid.
+     *
+     * @details Shared by all write_* helpers so numeric writes can format into a
+     *          stack buffer and copy straight into the map.
+     */
+    bool write_raw(const std::string &section, const std::string &key, const char *value, size_t length);
+
+    /**
+     * @brief Return the string a write to section/key should store its value in.
+     *
+     * @details Inside a transaction this is a new staged write, otherwise the
+     *          value in data (the handler is marked as modified).
+     */
+    std::string &value_slot(const std::string &section, const std::string &key);
+
+    /**
+     * @brief Return data[section][key], creating it if needed and counting new entries in footprint.
+     *
+     * @details Callers changing the returned value report its new capacity with resized().
+     */
+    std::string &data_slot(const std::string &section, const std::string &key);
+
+    /**
+     * @brief Update footprint after a string grew or shrank from before to after bytes of capacity.
+     */
+    void resized(size_t before, size_t after) { footprint = footprint - before + after; }
+
+    /**
+     * @brief Footprint of an entry of unparsed: its name, node and range list.
+     */
+    static size_t unparsed_size(const std::string &name, const std::vector<std::pair<std::streamoff, std::streamoff>> &ranges);
+
+    /**
+     * @brief Footprint of a section of data: its name, node and every key/value pair.
+     */
+    static size_t section_size(const std::string &name, const std::map<std::string, std::string> &pairs);
+
+    /**
+     * @brief Append an operation to the staging log, reusing a free slot if there is one.
+     */
+    StagedOp &stage(char type, const std::string &section, const std::string &key);
+
     /**
      * @brief Trim leading and trailing whitespace from a string (in-place).
      *
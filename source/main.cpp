@@ -8,6 +8,9 @@
 
 // self includes for the handler class
 #include "handler.hpp"
+#include "scheduler.hpp"
+#include "spiller.hpp"
+#include "container.hpp"
 #include "constants.hpp"
 
 // self includes for the native functions (our plugin development)
@@ -24,6 +27,20 @@ const AMX_NATIVE_INFO NATIVES[] = {
     {"INI_WriteString", Natives::Native_INI_WriteString},
     {"INI_WriteInt", Natives::Native_INI_WriteInt},
     {"INI_WriteFloat", Natives::Native_INI_WriteFloat},
+    {"INI_ReadIntArray", Natives::Native_INI_ReadIntArray},
+    {"INI_ReadFloatArray", Natives::Native_INI_ReadFloatArray},
+    {"INI_WriteIntArray", Natives::Native_INI_WriteIntArray},
+    {"INI_WriteFloatArray", Natives::Native_INI_WriteFloatArray},
+    {"INI_SetCompression", Natives::Native_INI_SetCompression},
+    {"INI_GetCompression", Natives::Native_INI_GetCompression},
+    {"INI_Begin", Natives::Native_INI_Begin},
+    {"INI_Commit", Natives::Native_INI_Commit},
+    {"INI_Rollback", Natives::Native_INI_Rollback},
+    {"INI_SetDeferredSave", Natives::Native_INI_SetDeferredSave},
+    {"INI_Flush", Natives::Native_INI_Flush},
+    {"INI_GetPendingSaves", Natives::Native_INI_GetPendingSaves},
+    {"INI_SetMemoryLimit", Natives::Native_INI_SetMemoryLimit},
+    {"INI_GetMemoryStats", Natives::Native_INI_GetMemoryStats},
     {"INI_DeleteKey", Natives::Native_INI_DeleteKey},
     {"INI_DeleteSection", Natives::Native_INI_DeleteSection},
     {"INI_SectionExists", Natives::Native_INI_SectionExists},
@@ -32,7 +49,7 @@ const AMX_NATIVE_INFO NATIVES[] = {
 
 PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports()
 {
-    return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES;
+    return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES | SUPPORTS_PROCESS_TICK;
 }
 
 PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData)
@@ -44,9 +61,26 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData)
 
 PLUGIN_EXPORT void PLUGIN_CALL Unload()
 {
+    // barrier: nothing that was closed may be lost on shutdown. Queued saves
+    // are older than any handle still open on the same path, so they go first
+    int flushed = Scheduler::flush_all();
+    if (flushed > 0)
+        logprintf("[pawn-ini | Info] Flushed %d deferred saves", flushed);
+    // handles scripts never closed are saved too (synchronously, nothing is deferred here)
+    int closed = Natives::CloseOwnedHandles(NULL);
+    if (closed > 0)
+        logprintf("[pawn-ini | Info] Closed %d handles left open", closed);
+    // only now, since the saves above may have gone into containers
+    Container::close_all();
     logprintf("[pawn-ini | Info] Plugin has been unloaded");
 }
 
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick()
+{
+    Scheduler::process();
+    Spiller::process();
+}
+
 PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx)
 {
     return amx_Register(amx, NATIVES, -1);
@@ -54,5 +88,9 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx)
 
 PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx)
 {
+    // a filterscript reload must not leak (or lose) the handles it left open
+    int closed = Natives::CloseOwnedHandles(amx);
+    if (closed > 0)
+        logprintf("[pawn-ini | Info] Closed %d handles left open by an unloaded script", closed);
     return AMX_ERR_NONE;
 }
\ No newline at end of file
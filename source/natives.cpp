@@ -1,14 +1,19 @@
 #include <map>
 #include <string>
+#include <vector>
 #include <cstring>
 
 #include "handler.hpp"
 #include "natives.hpp"
+#include "scheduler.hpp"
+#include "flusher.hpp"
+#include "spiller.hpp"
 #include "constants.hpp"
 
 // so we storage the the INI file handles
 std::map<int, Handler *> handlers; /** A map of file handles to Handler objects. */
 int next_handle = 1;               /** The next available handle, incremented for each new handler. */
+std::map<int, AMX *> owners;       /** The script that opened each handle, to clean up on AmxUnload. */
 
 std::string GetStringFromAMX(AMX *amx, cell param)
 {
@@ -27,6 +32,9 @@ std::string GetStringFromAMX(AMX *amx, cell param)
     return "";
 }
 
+// the array natives hand the Pawn cells straight to the handler
+static_assert(sizeof(cell) == sizeof(int) && sizeof(cell) == sizeof(float), "cell must be 32 bits");
+
 void SetStringToAMX(AMX *amx, cell param, const std::string &str, int maxlen)
 {
     cell *addr = NULL;
@@ -42,7 +50,12 @@ cell AMX_NATIVE_CALL Natives::Native_INI_Open(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Empty path provided for INI_Open");
         return 0;
     }
-    Handler *handler = new Handler(path);
+    // a file still waiting for its deferred save is newer than what is on disk
+    Handler *handler = Scheduler::reclaim(path);
+    // scripts compiled against older includes only pass the path
+    bool lazy = params[0] / static_cast<cell>(sizeof(cell)) >= 2 && params[2] != 0;
+    if (handler == NULL)
+        handler = new Handler(path, lazy);
     if (!handler->is_valid())
     {
         logprintf("[path-ini | Error] Failed to open INI file at %s", path.c_str());
@@ -51,6 +64,8 @@ cell AMX_NATIVE_CALL Natives::Native_INI_Open(AMX *amx, cell *params)
     }
     int handle = next_handle++;
     handlers[handle] = handler;
+    owners[handle] = amx;
+    Spiller::add(handler);
     logprintf("[pawn-ini | Info] Opened INI file at %s with handle %d", path.c_str(), handle);
     return handle;
 }
@@ -65,8 +80,11 @@ cell AMX_NATIVE_CALL Natives::Native_INI_Close(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_Close", handle);
         return 0;
     }
-    delete it->second;
+    Spiller::remove(it->second);
+    // saves now, or queues the save when deferred saving is enabled
+    Scheduler::close(it->second);
     handlers.erase(it);
+    owners.erase(handle);
     return 1;
 }
 
@@ -79,6 +97,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_ReadString(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_ReadString", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     int maxlen = params[5];
@@ -96,6 +115,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_ReadInt(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_ReadInt", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     int defval = params[4];
@@ -111,6 +131,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_ReadFloat(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_ReadFloat", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     float defval = amx_ctof(params[4]); // cell to float wow!
@@ -127,6 +148,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_WriteString(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_WriteString", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     std::string value = GetStringFromAMX(amx, params[4]);
@@ -142,6 +164,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_WriteInt(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_WriteInt", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     int value = params[4];
@@ -157,12 +180,186 @@ cell AMX_NATIVE_CALL Natives::Native_INI_WriteFloat(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_WriteFloat", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     float value = amx_ctof(params[4]);
     return it->second->write_float(section, key, value) ? 1 : 0;
 }
 
+cell AMX_NATIVE_CALL Natives::Native_INI_ReadIntArray(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_ReadIntArray", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    std::string section = GetStringFromAMX(amx, params[2]);
+    std::string key = GetStringFromAMX(amx, params[3]);
+    int size = params[5];
+    if (size <= 0)
+        return 0;
+    cell *dest = NULL;
+    amx_GetAddr(amx, params[4], &dest);
+    return it->second->read_int_array(section, key, reinterpret_cast<int *>(dest), size);
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_ReadFloatArray(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_ReadFloatArray", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    std::string section = GetStringFromAMX(amx, params[2]);
+    std::string key = GetStringFromAMX(amx, params[3]);
+    int size = params[5];
+    if (size <= 0)
+        return 0;
+    cell *dest = NULL;
+    amx_GetAddr(amx, params[4], &dest);
+    // Float: cells hold the raw float bits, same as amx_ctof/amx_ftoc
+    return it->second->read_float_array(section, key, reinterpret_cast<float *>(dest), size);
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_WriteIntArray(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_WriteIntArray", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    std::string section = GetStringFromAMX(amx, params[2]);
+    std::string key = GetStringFromAMX(amx, params[3]);
+    int count = params[5];
+    if (count < 0)
+        return 0;
+    cell *values = NULL;
+    amx_GetAddr(amx, params[4], &values);
+    return it->second->write_int_array(section, key, reinterpret_cast<const int *>(values), count) ? 1 : 0;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_WriteFloatArray(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_WriteFloatArray", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    std::string section = GetStringFromAMX(amx, params[2]);
+    std::string key = GetStringFromAMX(amx, params[3]);
+    int count = params[5];
+    if (count < 0)
+        return 0;
+    cell *values = NULL;
+    amx_GetAddr(amx, params[4], &values);
+    return it->second->write_float_array(section, key, reinterpret_cast<const float *>(values), count) ? 1 : 0;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_SetCompression(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_SetCompression", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    int level = params[2];
+    if (!it->second->set_compression(level))
+    {
+        logprintf("[pawn-ini | Error] Unsupported compression level %d provided for INI_SetCompression", level);
+        return 0;
+    }
+    return 1;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_GetCompression(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_GetCompression", handle);
+        return -1;
+    }
+    Spiller::touch(it->second);
+    return it->second->get_compression();
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_Begin(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_Begin", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    if (!it->second->begin())
+    {
+        logprintf("[pawn-ini | Error] Handle %d is already in a transaction", handle);
+        return 0;
+    }
+    return 1;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_Commit(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_Commit", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    if (!it->second->in_transaction())
+    {
+        logprintf("[pawn-ini | Error] INI_Commit called on handle %d without INI_Begin", handle);
+        return 0;
+    }
+    bool save = params[0] / static_cast<cell>(sizeof(cell)) >= 2 && params[2] != 0;
+    if (!it->second->commit(save))
+    {
+        logprintf("[pawn-ini | Error] Failed to save %s after commit", it->second->get_path().c_str());
+        return 0;
+    }
+    return 1;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_Rollback(AMX *amx, cell *params)
+{
+    int handle = params[1];
+    auto it = handlers.find(handle);
+    if (it == handlers.end())
+    {
+        logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_Rollback", handle);
+        return 0;
+    }
+    Spiller::touch(it->second);
+    if (!it->second->rollback())
+    {
+        logprintf("[pawn-ini | Error] INI_Rollback called on handle %d without INI_Begin", handle);
+        return 0;
+    }
+    return 1;
+}
+
 cell AMX_NATIVE_CALL Natives::Native_INI_DeleteKey(AMX *amx, cell *params)
 {
     int handle = params[1];
@@ -172,6 +369,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_DeleteKey(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_DeleteKey", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     return it->second->delete_key(section, key) ? 1 : 0;
@@ -186,6 +384,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_DeleteSection(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_DeleteSection", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     return it->second->delete_section(section) ? 1 : 0;
 }
@@ -199,6 +398,7 @@ cell AMX_NATIVE_CALL Natives::Native_INI_SectionExists(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_SectionExists", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     return it->second->section_exists(section) ? 1 : 0;
 }
@@ -212,7 +412,96 @@ cell AMX_NATIVE_CALL Natives::Native_INI_KeyExists(AMX *amx, cell *params)
         logprintf("[pawn-ini | Error] Invalid handle %d provided for INI_KeyExists", handle);
         return 0;
     }
+    Spiller::touch(it->second);
     std::string section = GetStringFromAMX(amx, params[2]);
     std::string key = GetStringFromAMX(amx, params[3]);
     return it->second->key_exists(section, key) ? 1 : 0;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_SetDeferredSave(AMX *amx, cell *params)
+{
+    bool enable = params[1] != 0;
+    int bytes_per_tick = params[2];
+    int ms_per_tick = params[3];
+    if (bytes_per_tick < 0 || ms_per_tick < 0)
+    {
+        logprintf("[pawn-ini | Error] Negative budget provided for INI_SetDeferredSave");
+        return 0;
+    }
+    Scheduler::configure(enable, static_cast<size_t>(bytes_per_tick), static_cast<unsigned int>(ms_per_tick));
+    return 1;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_Flush(AMX *amx, cell *params)
+{
+    return Scheduler::flush_all();
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_GetPendingSaves(AMX *amx, cell *params)
+{
+    return Scheduler::pending();
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_SetMemoryLimit(AMX *amx, cell *params)
+{
+    int limit = params[1];
+    if (limit < 0)
+    {
+        logprintf("[pawn-ini | Error] Negative limit provided for INI_SetMemoryLimit");
+        return 0;
+    }
+    Spiller::configure(static_cast<size_t>(limit));
+    return 1;
+}
+
+cell AMX_NATIVE_CALL Natives::Native_INI_GetMemoryStats(AMX *amx, cell *params)
+{
+    cell *addr = NULL;
+    amx_GetAddr(amx, params[1], &addr);
+    *addr = static_cast<cell>(Spiller::usage());
+    amx_GetAddr(amx, params[2], &addr);
+    *addr = static_cast<cell>(Spiller::spills());
+    amx_GetAddr(amx, params[3], &addr);
+    *addr = static_cast<cell>(Spiller::reloads());
+    return 1;
+}
+
+int Natives::CloseOwnedHandles(AMX *amx)
+{
+    std::vector<Handler *> modified;
+    int closed = 0;
+    for (auto it = handlers.begin(); it != handlers.end();)
+    {
+        auto owner = owners.find(it->first);
+        if (amx != NULL && (owner == owners.end() || owner->second != amx))
+        {
+            ++it;
+            continue;
+        }
+        Spiller::remove(it->second);
+        // unmodified handlers have nothing to write and are freed right away
+        if (it->second->is_modified())
+            modified.push_back(it->second);
+        else
+            delete it->second;
+        if (owner != owners.end())
+            owners.erase(owner);
+        it = handlers.erase(it);
+        ++closed;
+    }
+    std::vector<Handler *> unsaved;
+    Flusher::save_all(modified, FLUSH_TIMEOUT_MS, unsaved);
+    if (!unsaved.empty())
+    {
+        logprintf("[pawn-ini | Info] %d files could not be saved within %d ms, %s", static_cast<int>(unsaved.size()), FLUSH_TIMEOUT_MS, amx != NULL ? "deferring them" : "saving them now");
+        for (Handler *handler : unsaved)
+        {
+            // the server keeps ticking after a script unload, not after a shutdown
+            if (amx != NULL)
+                Scheduler::defer(handler);
+            else
+                delete handler;
+        }
+    }
+    return closed;
 }
\ No newline at end of file
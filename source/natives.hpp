@@ -26,6 +26,9 @@ public:
     /**
      * @brief Open or create an INI file and return a handle (or error code).
      *
+     * @details Expected params: path and an optional lazy flag (sections are
+     *          parsed on first access instead of on open).
+     *
      * @param amx Pointer to the AMX instance.
      * @param params Pointer to the native call parameters (AMX convention).
      * @return AMX cell containing the file handle on success or a negative/error code.
@@ -104,6 +107,87 @@ public:
      */
     static cell AMX_NATIVE_CALL Native_INI_WriteFloat(AMX *amx, cell *params);
 
+    /**
+     * @brief Read a delimited integer list into a Pawn array.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle, section, key, dest array, size).
+     * @return Number of elements written to the array.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_ReadIntArray(AMX *amx, cell *params);
+
+    /**
+     * @brief Read a delimited float list into a Pawn array.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle, section, key, dest array, size).
+     * @return Number of elements written to the array.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_ReadFloatArray(AMX *amx, cell *params);
+
+    /**
+     * @brief Write a Pawn integer array as a single delimited value.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle, section, key, values array, count).
+     * @return Non-zero on success, zero on failure.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_WriteIntArray(AMX *amx, cell *params);
+
+    /**
+     * @brief Write a Pawn float array as a single delimited value.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle, section, key, values array, count).
+     * @return Non-zero on success, zero on failure.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_WriteFloatArray(AMX *amx, cell *params);
+
+    /**
+     * @brief Select the gzip compression level used when the handle is saved.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle, level 0-9).
+     * @return Non-zero if the level was accepted, zero otherwise.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_SetCompression(AMX *amx, cell *params);
+
+    /**
+     * @brief Get the gzip compression level of a handle (0 means plain text).
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle).
+     * @return The compression level, or -1 for an invalid handle.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_GetCompression(AMX *amx, cell *params);
+
+    /**
+     * @brief Start a transaction: writes and deletes are staged until INI_Commit.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle).
+     * @return Non-zero on success, zero if the handle is invalid or already in a transaction.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_Begin(AMX *amx, cell *params);
+
+    /**
+     * @brief Apply the staged changes of a transaction, optionally saving the file.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle, optional save flag).
+     * @return Non-zero on success, zero if there is no transaction or the save failed.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_Commit(AMX *amx, cell *params);
+
+    /**
+     * @brief Discard the staged changes of a transaction.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: handle).
+     * @return Non-zero on success, zero if there is no transaction.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_Rollback(AMX *amx, cell *params);
+
     /**
      * @brief Delete a whole section from the INI.
      *
@@ -140,6 +224,63 @@ public:
      */
     static cell AMX_NATIVE_CALL Native_INI_KeyExists(AMX *amx, cell *params);
 
+    /**
+     * @brief Enable or disable deferred saving of closed handles.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: enable, bytes per tick, milliseconds per tick).
+     * @return Non-zero on success, zero if a budget is negative.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_SetDeferredSave(AMX *amx, cell *params);
+
+    /**
+     * @brief Write every queued deferred save immediately.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (none).
+     * @return Number of files written.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_Flush(AMX *amx, cell *params);
+
+    /**
+     * @brief Get the number of closed files still waiting to be saved.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (none).
+     * @return Number of queued saves.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_GetPendingSaves(AMX *amx, cell *params);
+
+    /**
+     * @brief Set the approximate memory all open handles may use before idle ones are spilled.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: limit in bytes, 0 = no limit).
+     * @return Non-zero on success, zero if the limit is negative.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_SetMemoryLimit(AMX *amx, cell *params);
+
+    /**
+     * @brief Get the memory used by open handles and the spill/reload counters.
+     *
+     * @param amx AMX instance pointer.
+     * @param params AMX native parameters (expected: usage, spills, reloads; all by reference).
+     * @return Always non-zero.
+     */
+    static cell AMX_NATIVE_CALL Native_INI_GetMemoryStats(AMX *amx, cell *params);
+
+    /**
+     * @brief Close every handle opened by a script, saving modified ones in parallel.
+     *
+     * @param amx Script whose handles are closed, or NULL to close all handles.
+     * @return Number of handles closed.
+     *
+     * @details Not a native: called from AmxUnload and Unload. Files that could
+     *          not be started within FLUSH_TIMEOUT_MS are deferred to the save
+     *          queue on AmxUnload and written synchronously on Unload.
+     */
+    static int CloseOwnedHandles(AMX *amx);
+
 private:
     /**
      * @brief Private constructor to prevent instantiation.
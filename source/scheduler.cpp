@@ -0,0 +1,127 @@
+#include <chrono>
+#include <deque>
+#include <map>
+
+#include "scheduler.hpp"
+#include "handler.hpp"
+#include "flusher.hpp"
+#include "constants.hpp"
+
+static bool enabled = false;        /** Whether INI_Close queues saves instead of writing immediately. */
+static size_t byte_budget = 0;      /** Approximate bytes written per tick, 0 = unlimited. */
+static unsigned int time_budget = 0; /** Milliseconds spent saving per tick, 0 = unlimited. */
+
+// queued handlers by path (so a second close of the same file coalesces) and
+// the order in which paths were first queued
+static std::map<std::string, Handler *> queued;
+static std::deque<std::string> order;
+
+void Scheduler::configure(bool enable, size_t bytes_per_tick, unsigned int ms_per_tick)
+{
+    byte_budget = bytes_per_tick;
+    time_budget = ms_per_tick;
+    if (enabled && !enable)
+        flush_all();
+    enabled = enable;
+}
+
+bool Scheduler::is_enabled()
+{
+    return enabled;
+}
+
+void Scheduler::close(Handler *handler)
+{
+    if (!enabled || !handler->is_modified())
+    {
+        delete handler;
+        return;
+    }
+    defer(handler);
+}
+
+void Scheduler::defer(Handler *handler)
+{
+    auto it = queued.find(handler->get_path());
+    if (it != queued.end())
+    {
+        // the newer contents win, exactly like two immediate saves would
+        it->second->discard_changes();
+        delete it->second;
+        it->second = handler;
+        return;
+    }
+    queued[handler->get_path()] = handler;
+    order.push_back(handler->get_path());
+}
+
+Handler *Scheduler::reclaim(const std::string &path)
+{
+    auto it = queued.find(path);
+    if (it == queued.end())
+        return NULL;
+    Handler *handler = it->second;
+    queued.erase(it);
+    // its slot in the order queue is skipped lazily by process()
+    return handler;
+}
+
+void Scheduler::process()
+{
+    if (queued.empty())
+    {
+        order.clear();
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    size_t written = 0;
+    bool first = true;
+    while (!order.empty())
+    {
+        if (!first)
+        {
+            if (byte_budget > 0 && written >= byte_budget)
+                break;
+            if (time_budget > 0 && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(time_budget))
+                break;
+        }
+        std::string path = order.front();
+        order.pop_front();
+        auto it = queued.find(path);
+        if (it == queued.end())
+            continue; // reclaimed by INI_Open meanwhile
+        Handler *handler = it->second;
+        queued.erase(it);
+        written += handler->estimated_size();
+        if (!handler->save())
+        {
+            logprintf("[pawn-ini | Error] Deferred save of %s failed, changes were lost", handler->get_path().c_str());
+            // do not let the destructor try again
+            handler->discard_changes();
+        }
+        delete handler;
+        first = false;
+    }
+}
+
+int Scheduler::flush_all()
+{
+    std::vector<Handler *> batch;
+    while (!order.empty())
+    {
+        auto it = queued.find(order.front());
+        order.pop_front();
+        if (it == queued.end())
+            continue;
+        batch.push_back(it->second);
+        queued.erase(it);
+    }
+    // no timeout: this is the barrier that guarantees nothing is lost
+    std::vector<Handler *> unsaved;
+    return Flusher::save_all(batch, 0, unsaved);
+}
+
+int Scheduler::pending()
+{
+    return static_cast<int>(queued.size());
+}
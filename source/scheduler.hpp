@@ -0,0 +1,110 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <string>
+#include <cstddef>
+
+class Handler;
+
+/**
+ * @file scheduler.hpp
+ * @brief Deferred save queue for closed INI handles.
+ *
+ * @details
+ * When deferred saving is enabled, closing a modified handle does not write
+ * the file immediately. The Handler is queued instead and written later from
+ * ProcessTick, a few files at a time, so a burst of INI_Close calls (e.g. every
+ * player disconnecting on a restart) is spread over several server ticks.
+ *
+ * Saves are coalesced by path: if the same file is closed again while still
+ * queued, only the latest contents are written, once, keeping the original
+ * queue position. Opening a path that is still queued takes the pending
+ * Handler back instead of re-reading stale data from disk.
+ *
+ * The class is non-instantiable; all functions are static.
+ *
+ * @note Like the rest of the plugin, this is only used from the server thread.
+ */
+class Scheduler
+{
+public:
+    /**
+     * @brief Enable or disable deferred saving.
+     *
+     * @param enable true to queue saves on close, false to save immediately.
+     * @param bytes_per_tick Approximate number of bytes written per tick (0 = no limit).
+     * @param ms_per_tick Time spent saving per tick, in milliseconds (0 = no limit).
+     *
+     * @details Disabling deferred saving flushes everything that is still queued.
+     *          At least one file is written per tick, whatever the budget.
+     */
+    static void configure(bool enable, size_t bytes_per_tick, unsigned int ms_per_tick);
+
+    /**
+     * @brief Return whether closes are currently deferred.
+     */
+    static bool is_enabled();
+
+    /**
+     * @brief Take ownership of a closed Handler.
+     *
+     * @param handler Handler being closed.
+     *
+     * @details Unmodified handlers (and every handler when deferred saving is
+     *          disabled) are destroyed right away. Modified handlers are queued,
+     *          replacing any pending Handler for the same path.
+     */
+    static void close(Handler *handler);
+
+    /**
+     * @brief Queue a modified Handler for saving, even if deferred saving is disabled.
+     *
+     * @param handler Handler whose save should happen on a later tick.
+     *
+     * @details Used for handles a parallel flush could not write before its timeout.
+     */
+    static void defer(Handler *handler);
+
+    /**
+     * @brief Remove and return the pending Handler for a path, if any.
+     *
+     * @param path File path passed to INI_Open.
+     * @return The queued Handler (caller takes ownership), or NULL if the path is not queued.
+     */
+    static Handler *reclaim(const std::string &path);
+
+    /**
+     * @brief Write queued files until this tick's budget is used up.
+     *
+     * @details Called from ProcessTick.
+     */
+    static void process();
+
+    /**
+     * @brief Write and free every queued file, ignoring the budget.
+     *
+     * @return Number of files written.
+     *
+     * @details Barrier used by INI_Flush and on plugin Unload so nothing is lost.
+     *          The files are written in parallel (see Flusher).
+     */
+    static int flush_all();
+
+    /**
+     * @brief Return the number of files waiting to be written.
+     */
+    static int pending();
+
+private:
+    /**
+     * @brief Private constructor to prevent instantiation.
+     */
+    Scheduler();
+
+    /**
+     * @brief Private destructor to prevent instantiation.
+     */
+    ~Scheduler();
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include <list>
+#include <map>
+
+#include "spiller.hpp"
+#include "handler.hpp"
+#include "constants.hpp"
+
+// where a handler sits in the LRU list and the tick it was last used in
+struct Tracked
+{
+    std::list<Handler *>::iterator position;
+    unsigned long long used;
+};
+
+static size_t limit = 0;              /** Memory ceiling in bytes, 0 = unlimited. */
+static unsigned long long tick = 0;   /** Number of process() calls so far. */
+static unsigned int spill_count = 0;  /** Handlers spilled so far. */
+static unsigned int reload_count = 0; /** Spilled handlers reloaded so far. */
+
+// most recently used first, spilled handlers included
+static std::list<Handler *> recent;
+static std::map<Handler *, Tracked> tracked;
+
+void Spiller::configure(size_t limit_bytes)
+{
+    limit = limit_bytes;
+}
+
+void Spiller::add(Handler *handler)
+{
+    recent.push_front(handler);
+    Tracked &entry = tracked[handler];
+    entry.position = recent.begin();
+    entry.used = tick;
+}
+
+void Spiller::remove(Handler *handler)
+{
+    auto it = tracked.find(handler);
+    if (it == tracked.end())
+        return;
+    recent.erase(it->second.position);
+    tracked.erase(it);
+}
+
+void Spiller::touch(Handler *handler)
+{
+    auto it = tracked.find(handler);
+    if (it == tracked.end())
+        return;
+    if (!handler->is_loaded())
+    {
+        ++reload_count;
+        if (!handler->reload())
+            logprintf("[pawn-ini | Error] Failed to reload %s after it was spilled", handler->get_path().c_str());
+    }
+    // splice() moves the node without invalidating the stored iterator
+    recent.splice(recent.begin(), recent, it->second.position);
+    it->second.used = tick;
+}
+
+void Spiller::process()
+{
+    // handlers used from here on belong to the next tick
+    unsigned long long current = tick++;
+    if (limit == 0)
+        return;
+    size_t total = usage();
+    if (total <= limit)
+        return;
+    for (auto it = recent.rbegin(); it != recent.rend() && total > limit; ++it)
+    {
+        Handler *handler = *it;
+        // every handler used since the last tick sits in front of this one: the
+        // script is likely still working with them, dropping them would only
+        // cost a reload on the next call
+        if (tracked[handler].used == current)
+            break;
+        if (!handler->is_loaded() || handler->in_transaction())
+            continue;
+        if (handler->is_modified() && !handler->save())
+        {
+            // keep the changes in memory, the next tick tries again
+            logprintf("[pawn-ini | Error] Failed to save %s while spilling it", handler->get_path().c_str());
+            continue;
+        }
+        size_t before = handler->memory_usage();
+        handler->unload();
+        total -= before - handler->memory_usage();
+        ++spill_count;
+    }
+}
+
+size_t Spiller::usage()
+{
+    // memory_usage() is a running total, so this only walks the handler list
+    size_t total = 0;
+    for (Handler *handler : recent)
+        total += handler->memory_usage();
+    return total;
+}
+
+unsigned int Spiller::spills()
+{
+    return spill_count;
+}
+
+unsigned int Spiller::reloads()
+{
+    return reload_count;
+}
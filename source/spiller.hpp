@@ -0,0 +1,96 @@
+#ifndef SPILLER_HPP
+#define SPILLER_HPP
+
+#include <cstddef>
+
+class Handler;
+
+/**
+ * @file spiller.hpp
+ * @brief Global memory ceiling for open handles.
+ *
+ * @details
+ * Scripts often keep a handle open for as long as a player is connected, so
+ * the memory held by the plugin grows with the player count, inside a 32-bit
+ * server process. Every open Handler is kept in a least-recently-used list.
+ * With a limit set, the handlers' approximate sizes are added up once per
+ * server tick and, while the total is over the limit, the least recently used
+ * handlers are spilled: saved if modified, then unloaded. Their handle IDs stay
+ * valid; the next native call on such a handle reloads the file transparently.
+ *
+ * Handlers with an open transaction are never spilled, and neither are handlers
+ * used since the previous tick, so the limit may stay exceeded while the script
+ * keeps working with many handles at once. Because the limit is only enforced
+ * on the tick, the total may also briefly exceed it within a tick.
+ *
+ * The class is non-instantiable; all functions are static.
+ *
+ * @note Like the rest of the plugin, this is only used from the server thread.
+ */
+class Spiller
+{
+public:
+    /**
+     * @brief Set the memory ceiling.
+     *
+     * @param limit_bytes Approximate bytes all open handles may use (0 = no limit).
+     *
+     * @details The new limit is enforced on the next server tick.
+     */
+    static void configure(size_t limit_bytes);
+
+    /**
+     * @brief Start tracking a newly opened Handler.
+     */
+    static void add(Handler *handler);
+
+    /**
+     * @brief Stop tracking a Handler that is being closed.
+     */
+    static void remove(Handler *handler);
+
+    /**
+     * @brief Mark a Handler as just used, reloading it first if it was spilled.
+     *
+     * @param handler Handler a native is about to use.
+     *
+     * @details Called by every native that takes a handle. A failed reload is
+     *          logged; the handler is then invalid and every call on it fails.
+     */
+    static void touch(Handler *handler);
+
+    /**
+     * @brief Spill handlers until the total fits in the limit.
+     *
+     * @details Called from ProcessTick. Does nothing without a limit.
+     */
+    static void process();
+
+    /**
+     * @brief Return the approximate memory used by all open handles, measured now.
+     */
+    static size_t usage();
+
+    /**
+     * @brief Return how many times a handler was spilled.
+     */
+    static unsigned int spills();
+
+    /**
+     * @brief Return how many times a spilled handler was reloaded.
+     */
+    static unsigned int reloads();
+
+private:
+    /**
+     * @brief Private constructor to prevent instantiation.
+     */
+    Spiller();
+
+    /**
+     * @brief Private destructor to prevent instantiation.
+     */
+    ~Spiller();
+};
+
+#endif
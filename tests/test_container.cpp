@@ -0,0 +1,186 @@
+/*
+ * pawn-ini regression tests: packed container recovery
+ *
+ * Covers how a "*.pack" container is reopened after things went wrong on
+ * disk: a torn append at the end, a damaged record in the middle, a file
+ * zeroed by a power loss, a stale index left next to a restored backup, and
+ * a document that can no longer be read.
+ *
+ * Usage: pawn-ini-test-container
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "handler.hpp"
+#include "container.hpp"
+#include "constants.hpp"
+
+static const std::string PACK = "pawn-ini-test.pack";
+static const std::string BACKUP = "pawn-ini-test-backup.pack";
+
+static void test_log(char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+    std::fputc('\n', stderr);
+}
+
+logprintf_t logprintf = test_log;
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+static void remove_pack(const std::string &path)
+{
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+    std::remove((path + ".compact").c_str());
+}
+
+// forget every open container, as if the server restarted after a crash
+static void restart(bool keep_index = false)
+{
+    Container::close_all();
+    if (!keep_index)
+        std::remove((PACK + ".idx").c_str());
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+static void save_doc(const std::string &pack, const std::string &key, int value)
+{
+    Handler handler(pack + ":" + key);
+    handler.write_int("Stats", "score", value);
+    handler.save();
+}
+
+static int read_doc(const std::string &key, bool &valid)
+{
+    Handler handler(PACK + ":" + key);
+    valid = handler.is_valid();
+    return handler.read_int("Stats", "score", -1);
+}
+
+// three documents, one record each, no index
+static void make_pack()
+{
+    remove_pack(PACK);
+    save_doc(PACK, "doc1", 1);
+    save_doc(PACK, "doc2", 2);
+    save_doc(PACK, "doc3", 3);
+    restart();
+}
+
+static void test_torn_tail()
+{
+    make_pack();
+    // a crash in the middle of an append: header and key, but not all the data
+    write_file(PACK, read_file(PACK) + std::string("PINI\x04\0\0\0\xff\0\0\0doc9[Sta", 23));
+    bool valid;
+    expect(read_doc("doc3", valid) == 3 && valid, "torn tail: earlier documents are intact");
+    save_doc(PACK, "doc4", 4);
+    restart();
+    expect(read_doc("doc1", valid) == 1 && valid, "torn tail: doc1 after the next append");
+    expect(read_doc("doc4", valid) == 4 && valid, "torn tail: the next append replaced the torn record");
+    restart();
+}
+
+static void test_corrupt_middle_record()
+{
+    make_pack();
+    std::string bytes = read_file(PACK);
+    size_t second = bytes.find("PINI", 1);
+    bytes[second] = 'X';
+    write_file(PACK, bytes);
+    bool valid;
+    read_doc("doc1", valid);
+    expect(!valid, "corrupt middle record: container is refused");
+    read_doc("doc3", valid);
+    expect(!valid, "corrupt middle record: later documents do not open as new ones");
+    save_doc(PACK, "doc1", 11);
+    restart();
+    // nothing was appended over the damage
+    expect(read_file(PACK) == bytes, "corrupt middle record: file left untouched");
+}
+
+static void test_zeroed_file()
+{
+    make_pack();
+    write_file(PACK, std::string(5000, '\0'));
+    bool valid;
+    read_doc("doc1", valid);
+    expect(!valid, "zeroed file: container is refused");
+    save_doc(PACK, "doc1", 11);
+    restart();
+    expect(read_file(PACK) == std::string(5000, '\0'), "zeroed file: nothing appended at offset 0");
+}
+
+static void test_stale_index()
+{
+    // a bigger "backup" with different record offsets than the live file
+    remove_pack(BACKUP);
+    save_doc(BACKUP, "padding", 0);
+    save_doc(BACKUP, "doc1", 100);
+    Container::close_all();
+    std::remove((BACKUP + ".idx").c_str());
+
+    remove_pack(PACK);
+    save_doc(PACK, "doc1", 1);
+    restart(true); // clean shutdown: the index is kept
+    write_file(PACK, read_file(BACKUP));
+
+    bool valid;
+    expect(read_doc("doc1", valid) == 100 && valid, "stale index: restored file is rescanned");
+    expect(read_doc("padding", valid) == 0 && valid, "stale index: documents only in the backup are found");
+    restart();
+    remove_pack(BACKUP);
+}
+
+static void test_unreadable_document()
+{
+    make_pack();
+    bool valid;
+    read_doc("doc1", valid);
+    // the container is open and indexed; now the end of the file disappears
+    std::string bytes = read_file(PACK);
+    write_file(PACK, bytes.substr(0, bytes.size() - 5));
+    read_doc("doc3", valid);
+    expect(!valid, "unreadable document: handle is invalid, not a new empty document");
+    restart();
+}
+
+int main()
+{
+    test_torn_tail();
+    test_corrupt_middle_record();
+    test_zeroed_file();
+    test_stale_index();
+    test_unreadable_document();
+    remove_pack(PACK);
+    std::printf("%s (%d failures)\n", failures == 0 ? "OK" : "FAILED", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * pawn-ini regression tests: lazy section loading
+ *
+ * A lazy handle records the byte range of every section on open and parses
+ * them on first access. If another handle saves the same path in between,
+ * those ranges point at the wrong bytes; the lazy handle must notice and
+ * re-index instead of parsing (and later saving back) garbage. Apart from
+ * when the parsing happens, a lazy handle must see the same document as an
+ * eager one.
+ *
+ * Usage: pawn-ini-test-lazy_sections
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "handler.hpp"
+#include "constants.hpp"
+
+static const char *TEST_FILE = "pawn-ini-test-lazy.ini";
+static const char *EAGER_FILE = "pawn-ini-test-eager.ini";
+
+static void test_log(char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+    std::fputc('\n', stderr);
+}
+
+logprintf_t logprintf = test_log;
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+static void test_rewritten_under_lazy_handle()
+{
+    std::remove(TEST_FILE);
+    {
+        Handler setup(TEST_FILE);
+        setup.write_string("A", "name", "alpha");
+        setup.write_string("B", "name", "bravo");
+        setup.write_int("B", "score", 42);
+        setup.write_string("C", "name", "charlie");
+        setup.save();
+    }
+
+    Handler lazy(TEST_FILE, true);
+    expect(lazy.read_string("A", "name") == "alpha", "lazy handle reads A");
+
+    // a second handle grows section A, moving B and C further into the file
+    {
+        Handler other(TEST_FILE);
+        other.write_string("A", "extra", "a much longer value that shifts everything after it");
+        other.save();
+    }
+
+    expect(lazy.read_string("B", "name") == "bravo", "lazy handle reads B after the rewrite");
+    lazy.write_int("A", "visits", 1);
+    expect(lazy.save(), "lazy handle saves");
+
+    Handler check(TEST_FILE);
+    expect(check.read_string("B", "name") == "bravo", "B.name survives on disk");
+    expect(check.read_int("B", "score") == 42, "B.score survives on disk");
+    expect(check.read_string("C", "name") == "charlie", "C.name survives on disk");
+    expect(check.read_int("A", "visits") == 1, "the lazy handle's write is on disk");
+    std::remove(TEST_FILE);
+}
+
+static std::string read_file(const char *path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const char *path, const std::string &bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+static void test_sections_without_keys()
+{
+    // B has no keys at all, C only comments and lines that are not keys,
+    // D has keys in its second block only
+    const std::string text =
+        "[A]\nname=alpha\n"
+        "[B]\n"
+        "[C]\n; comment\n# comment\n=no key\nno value\n"
+        "[D]\n\n"
+        "[E]\nname=echo\n"
+        "[D]\nname=delta\n";
+    write_file(TEST_FILE, text);
+    write_file(EAGER_FILE, text);
+
+    Handler lazy(TEST_FILE, true);
+    Handler eager(EAGER_FILE);
+    const char *sections[] = { "A", "B", "C", "D", "E" };
+    for (const char *section : sections)
+    {
+        std::string what = std::string("section ") + section + " exists in both modes or in neither";
+        expect(lazy.section_exists(section) == eager.section_exists(section), what.c_str());
+    }
+    expect(!lazy.section_exists("B") && !lazy.section_exists("C"), "sections without keys are not created");
+    expect(lazy.read_string("D", "name") == "delta", "D.name from its second block");
+
+    lazy.write_int("A", "visits", 1);
+    eager.write_int("A", "visits", 1);
+    expect(lazy.save() && eager.save(), "both handles save");
+    expect(read_file(TEST_FILE) == read_file(EAGER_FILE), "lazy and eager handles save the same bytes");
+    std::remove(TEST_FILE);
+    std::remove(EAGER_FILE);
+}
+
+int main()
+{
+    test_rewritten_under_lazy_handle();
+    test_sections_without_keys();
+    std::printf("%s (%d failures)\n", failures == 0 ? "OK" : "FAILED", failures);
+    return failures == 0 ? 0 : 1;
+}